@@ -58,6 +58,8 @@ extern ERL_NIF_TERM ATOM_LAST;
 extern ERL_NIF_TERM ATOM_NEXT;
 extern ERL_NIF_TERM ATOM_PREV;
 extern ERL_NIF_TERM ATOM_INVALID_ITERATOR;
+extern ERL_NIF_TERM ATOM_PACKED;
+extern ERL_NIF_TERM ATOM_CONTINUATION;
 extern ERL_NIF_TERM ATOM_CACHE_SIZE;
 extern ERL_NIF_TERM ATOM_PARANOID_CHECKS;
 extern ERL_NIF_TERM ATOM_ERROR_DB_DESTROY;
@@ -65,6 +67,13 @@ extern ERL_NIF_TERM ATOM_KEYS_ONLY;
 extern ERL_NIF_TERM ATOM_COMPRESSION;
 extern ERL_NIF_TERM ATOM_ERROR_DB_REPAIR;
 extern ERL_NIF_TERM ATOM_USE_BLOOMFILTER;
+extern ERL_NIF_TERM ATOM_TIMEOUT;
+extern ERL_NIF_TERM ATOM_CANCELLED;
+extern ERL_NIF_TERM ATOM_REPAIR_PROGRESS;
+extern ERL_NIF_TERM ATOM_LOGS;
+extern ERL_NIF_TERM ATOM_TABLES;
+extern ERL_NIF_TERM ATOM_ENTRIES;
+extern ERL_NIF_TERM ATOM_BYTES;
 
 }   // namespace eleveldb
 
@@ -0,0 +1,164 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_CPUSET_H
+    #include "cpuset.h"
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+    #include <pthread.h>
+#endif
+
+
+namespace eleveldb {
+
+bool
+ParseCpuList(
+    const char * Text,
+    CpuList & Cpus)
+{
+    const char * cursor;
+    char * end;
+    long first, last, loop;
+
+    Cpus.clear();
+    cursor=Text;
+
+    while ('\0'!=*cursor && '\n'!=*cursor)
+    {
+        first=strtol(cursor, &end, 10);
+        if (end==cursor || first<0)
+            return(false);
+
+        last=first;
+        cursor=end;
+        if ('-'==*cursor)
+        {
+            ++cursor;
+            last=strtol(cursor, &end, 10);
+            if (end==cursor || last<first)
+                return(false);
+            cursor=end;
+        }   // if
+
+        for (loop=first; loop<=last; ++loop)
+            Cpus.push_back((int)loop);
+
+        if (','==*cursor)
+            ++cursor;
+        else if ('\0'!=*cursor && '\n'!=*cursor)
+            return(false);
+    }   // while
+
+    std::sort(Cpus.begin(), Cpus.end());
+    Cpus.erase(std::unique(Cpus.begin(), Cpus.end()), Cpus.end());
+
+    return(true);
+
+}   // ParseCpuList
+
+
+/**
+ * Nodes are numbered densely on every system seen so far, stop at
+ *  the first missing one.
+ */
+void
+ReadNumaNodes(
+    std::vector<CpuList> & Nodes)
+{
+    char path[128], line[4096];
+    FILE * file;
+    int node;
+    CpuList cpus;
+
+    Nodes.clear();
+
+    for (node=0; ; ++node)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        file=fopen(path, "r");
+        if (NULL==file)
+            break;
+
+        if (NULL!=fgets(line, sizeof(line), file) && ParseCpuList(line, cpus))
+            Nodes.push_back(cpus);
+
+        fclose(file);
+    }   // for
+
+    return;
+
+}   // ReadNumaNodes
+
+
+void
+IntersectCpuList(
+    CpuList & Cpus,
+    const CpuList & Allowed)
+{
+    CpuList result;
+
+    std::set_intersection(Cpus.begin(), Cpus.end(), Allowed.begin(), Allowed.end(),
+                          std::back_inserter(result));
+    Cpus.swap(result);
+
+}   // IntersectCpuList
+
+
+ThreadAffinity::ThreadAffinity(
+    const CpuList & Cpus)
+    : m_Saved(false)
+{
+#if defined(__linux__)
+    cpu_set_t mask;
+    CpuList::const_iterator it;
+
+    if (!Cpus.empty()
+        && 0==pthread_getaffinity_np(pthread_self(), sizeof(m_Original), &m_Original))
+    {
+        CPU_ZERO(&mask);
+        for (it=Cpus.begin(); Cpus.end()!=it; ++it)
+            if (*it < CPU_SETSIZE)
+                CPU_SET(*it, &mask);
+
+        m_Saved=(0==pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask));
+    }   // if
+#endif
+
+}   // ThreadAffinity::ThreadAffinity
+
+
+ThreadAffinity::~ThreadAffinity()
+{
+#if defined(__linux__)
+    if (m_Saved)
+        pthread_setaffinity_np(pthread_self(), sizeof(m_Original), &m_Original);
+#endif
+
+}   // ThreadAffinity::~ThreadAffinity
+
+} // namespace eleveldb
@@ -0,0 +1,76 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_CPUSET_H
+#define INCL_CPUSET_H
+
+#include <vector>
+
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+namespace eleveldb {
+
+typedef std::vector<int> CpuList;        //!< sorted, unique cpu numbers
+
+
+// Linux cpulist syntax:  "0-3,8,10-11".  False on syntax error.
+bool ParseCpuList(const char * Text, CpuList & Cpus);
+
+// Online cpus of each NUMA node from sysfs, empty if not known.
+void ReadNumaNodes(std::vector<CpuList> & Nodes);
+
+// remove from Cpus any cpu not also in Allowed
+void IntersectCpuList(CpuList & Cpus, const CpuList & Allowed);
+
+
+/**
+ * Pins the calling thread to Cpus for the object's lifetime.
+ *  Threads created meanwhile inherit the mask (and with it
+ *  first-touch memory placement on the cpus' NUMA node), which is
+ *  how TaskPool places HotThreadPool threads it does not create
+ *  itself.  Empty Cpus or non-Linux:  does nothing.
+ */
+class ThreadAffinity
+{
+protected:
+    bool m_Saved;
+#if defined(__linux__)
+    cpu_set_t m_Original;
+#endif
+
+public:
+    explicit ThreadAffinity(const CpuList & Cpus);
+
+    ~ThreadAffinity();
+
+private:
+    ThreadAffinity();
+    ThreadAffinity(const ThreadAffinity &);             // nocopy
+    ThreadAffinity & operator=(const ThreadAffinity &); // nocopyassign
+};  // class ThreadAffinity
+
+} // namespace eleveldb
+
+
+#endif  // INCL_CPUSET_H
@@ -0,0 +1,118 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_DBSTATS_H
+    #include "dbstats.h"
+#endif
+
+#include <string.h>
+
+#if defined(__linux__)
+    #include <sched.h>
+#else
+    #include <pthread.h>
+#endif
+
+#include "leveldb/atomics.h"
+
+
+namespace eleveldb {
+
+DbCounters::DbCounters()
+{
+    uintptr_t line;
+
+    memset(m_Buffer, 0, sizeof(m_Buffer));
+
+    line=((uintptr_t)m_Buffer + m_LineSize - 1) & ~(uintptr_t)(m_LineSize - 1);
+    m_Shards=(DbCounterShard *)line;
+
+}   // DbCounters::DbCounters
+
+
+void
+DbCounters::Add(
+    DbCounter Counter,
+    uint64_t Amount)
+{
+    if (0!=Amount)
+        leveldb::add_and_fetch(&m_Shards[CurrentShard()].m_Counts[Counter], Amount);
+
+    return;
+
+}   // DbCounters::Add
+
+
+uint64_t
+DbCounters::Value(
+    DbCounter Counter) const
+{
+    uint64_t total;
+    size_t loop;
+
+    total=0;
+    for (loop=0; loop<m_ShardCount; ++loop)
+        total+=m_Shards[loop].m_Counts[Counter];
+
+    return(total);
+
+}   // DbCounters::Value
+
+
+const char *
+DbCounters::Name(
+    DbCounter Counter)
+{
+    static const char * names[eDbCounterCount]=
+        {"gets", "hits", "misses", "writes", "bytes_in", "bytes_out", "moves", "stalls"};
+
+    return(Counter<eDbCounterCount ? names[Counter] : "");
+
+}   // DbCounters::Name
+
+
+/**
+ * The shard only spreads the load, it need not be exact:  a thread
+ *  moved to another cpu between here and the add still adds atomically.
+ */
+size_t
+DbCounters::CurrentShard()
+{
+    size_t shard;
+
+#if defined(__linux__)
+    int cpu;
+
+    cpu=sched_getcpu();
+    shard=(0<=cpu ? (size_t)cpu : 0);
+#else
+    uintptr_t self;
+
+    self=(uintptr_t)pthread_self();
+    shard=(size_t)(self ^ (self >> 12));
+#endif
+
+    return(shard & (m_ShardCount - 1));
+
+}   // DbCounters::CurrentShard
+
+} // namespace eleveldb
@@ -0,0 +1,96 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_DBSTATS_H
+#define INCL_DBSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace eleveldb {
+
+
+/**
+ * Operation and byte counters kept by each DbObject, see DbCounters
+ */
+enum DbCounter
+{
+    eDbGets=0,            //!< GetTask runs
+    eDbHits=1,            //!< ... that found the key
+    eDbMisses=2,          //!< ... that did not
+    eDbWrites=3,          //!< WriteTask runs
+    eDbBytesIn=4,         //!< key and value bytes given to writes
+    eDbBytesOut=5,        //!< value bytes returned by gets, key/value bytes by moves
+    eDbMoves=6,           //!< MoveTask runs
+    eDbStalls=7,          //!< iterator moves that arrived before their prefetch finished
+    eDbCounterCount=8
+};
+
+
+/**
+ * One cpu's copy of the counters.  Exactly one cache line, and
+ *  DbCounters aligns the array, so cpus never share a line.
+ */
+struct DbCounterShard
+{
+    volatile uint64_t m_Counts[eDbCounterCount];
+};  // struct DbCounterShard
+
+
+/**
+ * Per database counters, sharded by the cpu of the calling thread so
+ *  a hot database does not bounce one cache line between all the
+ *  worker threads.  Updated with atomics, Value() sums the shards
+ *  without locks and so is only a near instant view.
+ */
+class DbCounters
+{
+public:
+    static const size_t m_ShardCount=16;     //!< power of 2, cpus beyond share shards
+    static const size_t m_LineSize=64;
+
+protected:
+    // one spare line so m_Shards can start on a line boundary
+    char m_Buffer[(m_ShardCount+1) * m_LineSize];
+    DbCounterShard * m_Shards;
+
+public:
+    DbCounters();
+
+    void Add(DbCounter Counter, uint64_t Amount=1);
+
+    uint64_t Value(DbCounter Counter) const;
+
+    static const char * Name(DbCounter Counter);
+
+protected:
+    static size_t CurrentShard();
+
+private:
+    DbCounters(const DbCounters &);             // nocopy
+    DbCounters & operator=(const DbCounters &); // nocopyassign
+};  // class DbCounters
+
+} // namespace eleveldb
+
+
+#endif  // INCL_DBSTATS_H
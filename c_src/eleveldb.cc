@@ -53,6 +53,14 @@
     #include "atoms.h"
 #endif
 
+#ifndef INCL_TASKPOOL_H
+    #include "taskpool.h"
+#endif
+
+#ifndef INCL_GOVERNOR_H
+    #include "governor.h"
+#endif
+
 #include "work_result.hpp"
 
 #include "leveldb/atomics.h"
@@ -61,9 +69,26 @@ static ErlNifFunc nif_funcs[] =
 {
     {"async_close", 2, eleveldb::async_close},
     {"async_iterator_close", 2, eleveldb::async_iterator_close},
-    {"status", 2, eleveldb_status},
+    {"async_merge_iterator", 3, eleveldb::async_merge_iterator},
+    {"async_merge_iterator", 4, eleveldb::async_merge_iterator},
+    {"async_merge_iterator_move", 4, eleveldb::async_merge_iterator_move},
+    {"async_merge_iterator_close", 2, eleveldb::async_merge_iterator_close},
+    {"status_int", 2, eleveldb_status},
+    {"pool_status", 0, eleveldb_pool_status},
+    {"set_threads", 1, eleveldb_set_threads},
+    {"memory_status", 0, eleveldb_memory_status},
+    {"task_latency_int", 0, eleveldb_task_latency},
+    {"metrics_int", 0, eleveldb_metrics},
+    {"db_stats_int", 1, eleveldb_db_stats},
+    {"iterators_int", 1, eleveldb_iterators},
+    {"cancel_token", 0, eleveldb_cancel_token},
+    {"cancel", 1, eleveldb_cancel},
     {"async_destroy", 3, eleveldb::async_destroy},
-    {"repair", 2, eleveldb_repair},
+    {"async_status", 3, eleveldb::async_status},
+    {"async_repair", 3, eleveldb::async_repair},
+    {"async_shrink_caches", 2, eleveldb::async_shrink_caches},
+    {"async_close_idle_iterators", 3, eleveldb::async_close_idle_iterators},
+    {"repair_int", 2, eleveldb_repair},
     {"is_empty", 1, eleveldb_is_empty},
 
     {"async_open", 3, eleveldb::async_open},
@@ -73,7 +98,9 @@ static ErlNifFunc nif_funcs[] =
     {"async_iterator", 3, eleveldb::async_iterator},
     {"async_iterator", 4, eleveldb::async_iterator},
 
-    {"async_iterator_move", 3, eleveldb::async_iterator_move}
+    {"async_iterator_move", 3, eleveldb::async_iterator_move},
+    {"async_iterator_move", 4, eleveldb::async_iterator_move},
+    {"async_iterator_queue_move", 2, eleveldb::async_iterator_queue_move}
 };
 
 
@@ -113,7 +140,19 @@ ERL_NIF_TERM ATOM_NEXT;
 ERL_NIF_TERM ATOM_PREV;
 ERL_NIF_TERM ATOM_PREFETCH;
 ERL_NIF_TERM ATOM_PREFETCH_STOP;
+ERL_NIF_TERM ATOM_PREFETCH_DEPTH;
+ERL_NIF_TERM ATOM_ITERATOR_REFRESH_INTERVAL;
+ERL_NIF_TERM ATOM_ITERATOR_REFRESH_MOVES;
+ERL_NIF_TERM ATOM_ITERATOR_REFRESH_BYTES;
+ERL_NIF_TERM ATOM_ITERATOR_POOL_SIZE;
+ERL_NIF_TERM ATOM_SCAN_MODE;
+ERL_NIF_TERM ATOM_SEQUENTIAL;
 ERL_NIF_TERM ATOM_INVALID_ITERATOR;
+ERL_NIF_TERM ATOM_PACKED;
+ERL_NIF_TERM ATOM_CONTINUATION;
+ERL_NIF_TERM ATOM_RESUME;
+ERL_NIF_TERM ATOM_SNAPSHOT;
+ERL_NIF_TERM ATOM_NONE;
 ERL_NIF_TERM ATOM_PARANOID_CHECKS;
 ERL_NIF_TERM ATOM_VERIFY_COMPACTIONS;
 ERL_NIF_TERM ATOM_ERROR_DB_DESTROY;
@@ -132,6 +171,79 @@ ERL_NIF_TERM ATOM_BLOCK_CACHE_THRESHOLD;
 ERL_NIF_TERM ATOM_IS_INTERNAL_DB;
 ERL_NIF_TERM ATOM_LIMITED_DEVELOPER_MEM;
 ERL_NIF_TERM ATOM_ELEVELDB_THREADS;
+ERL_NIF_TERM ATOM_ELEVELDB_POOL_SHARDS;
+ERL_NIF_TERM ATOM_THREADS;
+ERL_NIF_TERM ATOM_SHARDS;
+ERL_NIF_TERM ATOM_QUEUE_DEPTH;
+ERL_NIF_TERM ATOM_SUBMITTED;
+ERL_NIF_TERM ATOM_DIRECT;
+ERL_NIF_TERM ATOM_STOLEN;
+ERL_NIF_TERM ATOM_QUEUED;
+ERL_NIF_TERM ATOM_ELEVELDB_BULK_THREADS;
+ERL_NIF_TERM ATOM_ELEVELDB_ADMIN_THREADS;
+ERL_NIF_TERM ATOM_ELEVELDB_CPU_SET;
+ERL_NIF_TERM ATOM_ELEVELDB_NUMA;
+ERL_NIF_TERM ATOM_CPUS;
+ERL_NIF_TERM ATOM_CLASSES;
+ERL_NIF_TERM ATOM_RESIZES;
+ERL_NIF_TERM ATOM_RETIRING;
+ERL_NIF_TERM ATOM_GET;
+ERL_NIF_TERM ATOM_WRITE;
+ERL_NIF_TERM ATOM_MOVE;
+ERL_NIF_TERM ATOM_OPEN;
+ERL_NIF_TERM ATOM_CLOSE;
+ERL_NIF_TERM ATOM_OTHER;
+ERL_NIF_TERM ATOM_WAIT;
+ERL_NIF_TERM ATOM_SERVICE;
+ERL_NIF_TERM ATOM_COUNT;
+ERL_NIF_TERM ATOM_P50;
+ERL_NIF_TERM ATOM_P99;
+ERL_NIF_TERM ATOM_P999;
+ERL_NIF_TERM ATOM_MAX;
+ERL_NIF_TERM ATOM_DEADLINE;
+ERL_NIF_TERM ATOM_CANCEL;
+ERL_NIF_TERM ATOM_TIMEOUT;
+ERL_NIF_TERM ATOM_CANCELLED;
+ERL_NIF_TERM ATOM_EXPIRED;
+ERL_NIF_TERM ATOM_INTERACTIVE;
+ERL_NIF_TERM ATOM_BULK;
+ERL_NIF_TERM ATOM_ADMIN;
+ERL_NIF_TERM ATOM_BORROWED;
+ERL_NIF_TERM ATOM_STARTED;
+ERL_NIF_TERM ATOM_WAIT_US;
+ERL_NIF_TERM ATOM_WAIT_MAX_US;
+ERL_NIF_TERM ATOM_RUN_US;
+ERL_NIF_TERM ATOM_DIRTY_IO;
+ERL_NIF_TERM ATOM_REPAIR_PROGRESS;
+ERL_NIF_TERM ATOM_LOGS;
+ERL_NIF_TERM ATOM_TABLES;
+ERL_NIF_TERM ATOM_ENTRIES;
+ERL_NIF_TERM ATOM_BYTES;
+ERL_NIF_TERM ATOM_ELEVELDB_MEMORY_INTERVAL;
+ERL_NIF_TERM ATOM_BUDGET;
+ERL_NIF_TERM ATOM_USED;
+ERL_NIF_TERM ATOM_REBALANCES;
+ERL_NIF_TERM ATOM_DATABASES;
+ERL_NIF_TERM ATOM_NAME;
+ERL_NIF_TERM ATOM_BLOCK_CACHE;
+ERL_NIF_TERM ATOM_FILE_CACHE;
+ERL_NIF_TERM ATOM_MEMTABLE;
+ERL_NIF_TERM ATOM_TASKS;
+ERL_NIF_TERM ATOM_CGROUP_LIMIT;
+ERL_NIF_TERM ATOM_ELEVELDB_MEMORY_HIGH_WATERMARK;
+ERL_NIF_TERM ATOM_SHED_PERCENT;
+ERL_NIF_TERM ATOM_RECLAIMED;
+ERL_NIF_TERM ATOM_PERF;
+ERL_NIF_TERM ATOM_ITERATORS;
+ERL_NIF_TERM ATOM_SNAPSHOTS;
+ERL_NIF_TERM ATOM_PINNED_BYTES;
+ERL_NIF_TERM ATOM_POOLED;
+ERL_NIF_TERM ATOM_BUSY;
+ERL_NIF_TERM ATOM_ITERATOR_IDLE_CLOSE;
+ERL_NIF_TERM ATOM_AGE;
+ERL_NIF_TERM ATOM_IDLE;
+ERL_NIF_TERM ATOM_MOVES;
+ERL_NIF_TERM ATOM_OWNER;
 ERL_NIF_TERM ATOM_FADVISE_WILLNEED;
 ERL_NIF_TERM ATOM_DELETE_THRESHOLD;
 ERL_NIF_TERM ATOM_TIERED_SLOW_LEVEL;
@@ -151,8 +263,24 @@ struct eleveldb_itr_handle;
 class eleveldb_thread_pool;
 class eleveldb_priv_data;
 
+// {deadline, Ms} is compared with erlang:monotonic_time(millisecond) (OTP 18.3+)
+#if ERL_NIF_MAJOR_VERSION > 2 || (ERL_NIF_MAJOR_VERSION == 2 && ERL_NIF_MINOR_VERSION >= 10)
+    #define ELEVELDB_DEADLINE 1
+#endif
+
+// {dirty_io, true} needs enif_schedule_nif and enif_thread_type (OTP 19+)
+#if ERL_NIF_MAJOR_VERSION > 2 || (ERL_NIF_MAJOR_VERSION == 2 && ERL_NIF_MINOR_VERSION >= 11)
+    #define ELEVELDB_DIRTY_IO 1
+#endif
+
 static volatile uint64_t gCurrentTotalMemory=0;
 
+// leveldb perf counter names as atoms, made once by on_load for eleveldb_metrics
+static ERL_NIF_TERM gPerfCounterAtoms[leveldb::ePerfCountEnumSize];
+
+// DbCounters names as atoms, made once by on_load for eleveldb_db_stats
+static ERL_NIF_TERM gDbCounterAtoms[eleveldb::eDbCounterCount];
+
 // Erlang helpers:
 ERL_NIF_TERM error_einval(ErlNifEnv* env)
 {
@@ -181,6 +309,9 @@ static ERL_NIF_TERM slice_to_binary(ErlNifEnv* env, leveldb::Slice s)
 struct EleveldbOptions
 {
     int m_EleveldbThreads;
+    int m_EleveldbPoolShards;
+    int m_EleveldbBulkThreads;
+    int m_EleveldbAdminThreads;
     int m_LeveldbImmThreads;
     int m_LeveldbBGWriteThreads;
     int m_LeveldbOverlapThreads;
@@ -192,17 +323,32 @@ struct EleveldbOptions
     bool m_LimitedDeveloper;
     bool m_FadviseWillNeed;
 
+    size_t m_IteratorPoolSize;
+    unsigned m_IteratorIdleClose;   //!< seconds without a move before an iterator is closed, 0 never
+
+    eleveldb::CpuList m_CpuSet;
+    bool m_Numa;
+
+    unsigned m_MemoryInterval;      //!< seconds between memory rebalances, 0 disables
+    unsigned m_MemoryHighWatermark; //!< percent of memory that starts shedding, 0 disables
+
     EleveldbOptions()
-        : m_EleveldbThreads(71),
+        : m_EleveldbThreads(71), m_EleveldbPoolShards(1),
+          m_EleveldbBulkThreads(0), m_EleveldbAdminThreads(0),
           m_LeveldbImmThreads(0), m_LeveldbBGWriteThreads(0),
           m_LeveldbOverlapThreads(0), m_LeveldbGroomingThreads(0),
           m_TotalMemPercent(0), m_TotalMem(0),
-          m_LimitedDeveloper(false), m_FadviseWillNeed(false)
+          m_LimitedDeveloper(false), m_FadviseWillNeed(false),
+          m_IteratorPoolSize(16), m_IteratorIdleClose(0), m_Numa(false), m_MemoryInterval(10),
+          m_MemoryHighWatermark(0)
         {};
 
     void Dump()
     {
         syslog(LOG_ERR, "         m_EleveldbThreads: %d\n", m_EleveldbThreads);
+        syslog(LOG_ERR, "      m_EleveldbPoolShards: %d\n", m_EleveldbPoolShards);
+        syslog(LOG_ERR, "     m_EleveldbBulkThreads: %d\n", m_EleveldbBulkThreads);
+        syslog(LOG_ERR, "    m_EleveldbAdminThreads: %d\n", m_EleveldbAdminThreads);
         syslog(LOG_ERR, "       m_LeveldbImmThreads: %d\n", m_LeveldbImmThreads);
         syslog(LOG_ERR, "   m_LeveldbBGWriteThreads: %d\n", m_LeveldbBGWriteThreads);
         syslog(LOG_ERR, "   m_LeveldbOverlapThreads: %d\n", m_LeveldbOverlapThreads);
@@ -213,6 +359,12 @@ struct EleveldbOptions
 
         syslog(LOG_ERR, "        m_LimitedDeveloper: %s\n", (m_LimitedDeveloper ? "true" : "false"));
         syslog(LOG_ERR, "         m_FadviseWillNeed: %s\n", (m_FadviseWillNeed ? "true" : "false"));
+        syslog(LOG_ERR, "        m_IteratorPoolSize: %zd\n", m_IteratorPoolSize);
+        syslog(LOG_ERR, "       m_IteratorIdleClose: %u\n", m_IteratorIdleClose);
+        syslog(LOG_ERR, "                  m_CpuSet: %zd cpus\n", m_CpuSet.size());
+        syslog(LOG_ERR, "                    m_Numa: %s\n", (m_Numa ? "true" : "false"));
+        syslog(LOG_ERR, "          m_MemoryInterval: %u\n", m_MemoryInterval);
+        syslog(LOG_ERR, "     m_MemoryHighWatermark: %u\n", m_MemoryHighWatermark);
     }   // Dump
 };  // struct EleveldbOptions
 
@@ -224,13 +376,16 @@ class eleveldb_priv_data
 {
 public:
     EleveldbOptions m_Opts;
-    leveldb::HotThreadPool thread_pool;
+    eleveldb::MemoryGovernor m_Governor;   // before thread_pool, its tasks use it
+    eleveldb::TaskPool thread_pool;
 
     explicit eleveldb_priv_data(EleveldbOptions & Options)
     : m_Opts(Options),
-      thread_pool(Options.m_EleveldbThreads, "Eleveldb",
-                  leveldb::ePerfElevelDirect, leveldb::ePerfElevelQueued,
-                  leveldb::ePerfElevelDequeued, leveldb::ePerfElevelWeighted)
+      m_Governor(Options.m_MemoryInterval, Options.m_TotalMem, Options.m_TotalMemPercent,
+                 Options.m_MemoryHighWatermark),
+      thread_pool(Options.m_EleveldbThreads, Options.m_EleveldbPoolShards,
+                  Options.m_EleveldbBulkThreads, Options.m_EleveldbAdminThreads,
+                  Options.m_CpuSet, Options.m_Numa)
         {}
 
 private:
@@ -241,6 +396,39 @@ private:
 };
 
 
+/**
+ * Hand a due memory rebalance to the admin class, see MemoryGovernor.
+ *  Also releases thread pools retired by set_threads once drained.
+ */
+static void
+poll_governor(
+    eleveldb_priv_data & priv)
+{
+    ERL_NIF_TERM no_ref(0);
+
+    if (priv.m_Governor.RebalanceDue())
+    {
+        eleveldb::WorkTask * work_item=new eleveldb::RebalanceTask(NULL, no_ref, &priv.m_Governor);
+
+        if (!priv.thread_pool.Submit(work_item))
+        {
+            delete work_item;
+            priv.m_Governor.Reschedule();
+        }   // if
+    }   // if
+
+    // a failed submit is retried by the next due poll
+    if (priv.thread_pool.ReapDue())
+    {
+        eleveldb::WorkTask * work_item=new eleveldb::ReapTask(NULL, no_ref, &priv.thread_pool);
+
+        if (!priv.thread_pool.Submit(work_item))
+            delete work_item;
+    }   // if
+
+}   // poll_governor
+
+
 ERL_NIF_TERM parse_init_option(ErlNifEnv* env, ERL_NIF_TERM item, EleveldbOptions& opts)
 {
     int arity;
@@ -298,15 +486,86 @@ ERL_NIF_TERM parse_init_option(ErlNifEnv* env, ERL_NIF_TERM item, EleveldbOption
                 }   // if
             }   // if
         }   // if
+        else if (option[0] == eleveldb::ATOM_ELEVELDB_POOL_SHARDS)
+        {
+            unsigned long temp;
+            if (enif_get_ulong(env, option[1], &temp) && 0!=temp)
+                opts.m_EleveldbPoolShards = temp;
+        }   // else if
+        else if (option[0] == eleveldb::ATOM_ELEVELDB_BULK_THREADS)
+        {
+            unsigned long temp;
+            if (enif_get_ulong(env, option[1], &temp))
+                opts.m_EleveldbBulkThreads = temp;
+        }   // else if
+        else if (option[0] == eleveldb::ATOM_ELEVELDB_ADMIN_THREADS)
+        {
+            unsigned long temp;
+            if (enif_get_ulong(env, option[1], &temp))
+                opts.m_EleveldbAdminThreads = temp;
+        }   // else if
+        else if (option[0] == eleveldb::ATOM_ELEVELDB_CPU_SET)
+        {
+            char cpus[1024];
+            eleveldb::CpuList temp;
+            if (enif_get_string(env, option[1], cpus, sizeof(cpus), ERL_NIF_LATIN1)
+                && eleveldb::ParseCpuList(cpus, temp))
+                opts.m_CpuSet.swap(temp);
+        }   // else if
+        else if (option[0] == eleveldb::ATOM_ELEVELDB_NUMA)
+        {
+            opts.m_Numa = (option[1] == eleveldb::ATOM_TRUE);
+        }   // else if
         else if (option[0] == eleveldb::ATOM_FADVISE_WILLNEED)
         {
             opts.m_FadviseWillNeed = (option[1] == eleveldb::ATOM_TRUE);
         }   // else if
+        else if (option[0] == eleveldb::ATOM_ITERATOR_POOL_SIZE)
+        {
+            unsigned long pool_size;
+            if (enif_get_ulong(env, option[1], &pool_size))
+                opts.m_IteratorPoolSize = pool_size;
+        }   // else if
+        else if (option[0] == eleveldb::ATOM_ITERATOR_IDLE_CLOSE)
+        {
+            unsigned long seconds;
+            if (enif_get_ulong(env, option[1], &seconds))
+                opts.m_IteratorIdleClose = seconds;
+        }   // else if
+        else if (option[0] == eleveldb::ATOM_ELEVELDB_MEMORY_INTERVAL)
+        {
+            unsigned long seconds;
+            if (enif_get_ulong(env, option[1], &seconds))
+                opts.m_MemoryInterval = seconds;
+        }   // else if
+        else if (option[0] == eleveldb::ATOM_ELEVELDB_MEMORY_HIGH_WATERMARK)
+        {
+            unsigned long percent;
+            if (enif_get_ulong(env, option[1], &percent) && percent<=100)
+                opts.m_MemoryHighWatermark = percent;
+        }   // else if
     }
 
     return eleveldb::ATOM_OK;
 }
 
+// eleveldb's own open option, leveldb::Options has no place for it
+ERL_NIF_TERM parse_dirty_io_option(ErlNifEnv* env, ERL_NIF_TERM item, bool& dirty_io)
+{
+    int arity;
+    const ERL_NIF_TERM* option;
+
+    if (enif_get_tuple(env, item, &arity, &option) && 2==arity
+        && option[0] == eleveldb::ATOM_DIRTY_IO)
+    {
+#ifdef ELEVELDB_DIRTY_IO
+        dirty_io = (option[1] == eleveldb::ATOM_TRUE);
+#endif
+    }   // if
+
+    return eleveldb::ATOM_OK;
+}
+
 ERL_NIF_TERM parse_open_option(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::Options& opts)
 {
     int arity;
@@ -544,6 +803,70 @@ ERL_NIF_TERM parse_read_option(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::ReadO
     return eleveldb::ATOM_OK;
 }
 
+ERL_NIF_TERM parse_iterator_option(ErlNifEnv* env, ERL_NIF_TERM item, eleveldb::IteratorOptions& opts)
+{
+    int arity;
+    const ERL_NIF_TERM* option;
+    if (enif_get_tuple(env, item, &arity, &option) && 2==arity)
+    {
+        if (option[0] == eleveldb::ATOM_PREFETCH_DEPTH)
+        {
+            unsigned long depth;
+            if (enif_get_ulong(env, option[1], &depth))
+            {
+                // upper limit keeps a careless setting from claiming
+                //  huge amounts of memory per iterator
+                opts.m_PrefetchDepth = (depth <= 4096 ? depth : 4096);
+            }
+        }
+        else if (option[0] == eleveldb::ATOM_SCAN_MODE)
+            opts.m_Sequential = (option[1] == eleveldb::ATOM_SEQUENTIAL);
+        else if (option[0] == eleveldb::ATOM_SNAPSHOT)
+            opts.m_NoSnapshot = (option[1] == eleveldb::ATOM_NONE);
+        else if (option[0] == eleveldb::ATOM_RESUME)
+        {
+            // token from iterator_move(Itr, continuation), version 1 only
+            ErlNifBinary token;
+            if (enif_inspect_binary(env, option[1], &token) && 2<=token.size
+                && 1==token.data[0] && token.data[1]<=1)
+            {
+                opts.m_Resume = true;
+                opts.m_ResumeReverse = (1==token.data[1]);
+                opts.m_ResumeKey.assign((const char *)token.data + 2, token.size - 2);
+            }
+        }
+        else if (option[0] == eleveldb::ATOM_ITERATOR_REFRESH_INTERVAL)
+        {
+            unsigned int seconds;
+            if (enif_get_uint(env, option[1], &seconds))
+            {
+                opts.m_RefreshInterval = seconds;
+                opts.m_RefreshPolicy = true;
+            }
+        }
+        else if (option[0] == eleveldb::ATOM_ITERATOR_REFRESH_MOVES)
+        {
+            unsigned long moves;
+            if (enif_get_ulong(env, option[1], &moves))
+            {
+                opts.m_RefreshMoves = moves;
+                opts.m_RefreshPolicy = true;
+            }
+        }
+        else if (option[0] == eleveldb::ATOM_ITERATOR_REFRESH_BYTES)
+        {
+            unsigned long bytes;
+            if (enif_get_ulong(env, option[1], &bytes))
+            {
+                opts.m_RefreshBytes = bytes;
+                opts.m_RefreshPolicy = true;
+            }
+        }
+    }
+
+    return eleveldb::ATOM_OK;
+}
+
 ERL_NIF_TERM parse_write_option(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::WriteOptions& opts)
 {
     int arity;
@@ -557,8 +880,92 @@ ERL_NIF_TERM parse_write_option(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::Writ
     return eleveldb::ATOM_OK;
 }
 
-ERL_NIF_TERM write_batch_item(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::WriteBatch& batch)
+/**
+ * {deadline, MonotonicMs} and {cancel, Token} of get, write and
+ *  iterator_move.  Parsed separately since neither belongs in the
+ *  leveldb options.
+ */
+struct TaskLimits
+{
+    bool m_HasDeadline;
+    long m_DeadlineMs;                      //!< erlang:monotonic_time(millisecond)
+    eleveldb::CancelObject * m_Cancel;
+
+    TaskLimits() : m_HasDeadline(false), m_DeadlineMs(0), m_Cancel(NULL) {};
+
+    void Apply(eleveldb::WorkTask * Task) const;
+};
+
+
+ERL_NIF_TERM parse_limit_option(ErlNifEnv* env, ERL_NIF_TERM item, TaskLimits& limits)
+{
+    int arity;
+    const ERL_NIF_TERM* option;
+    if (enif_get_tuple(env, item, &arity, &option) && 2==arity)
+    {
+        if (option[0] == eleveldb::ATOM_CANCEL)
+            limits.m_Cancel = eleveldb::CancelObject::RetrieveCancelObject(env, option[1]);
+#ifdef ELEVELDB_DEADLINE
+        else if (option[0] == eleveldb::ATOM_DEADLINE)
+            limits.m_HasDeadline = (0 != enif_get_long(env, option[1], &limits.m_DeadlineMs));
+#endif
+    }
+
+    return eleveldb::ATOM_OK;
+}
+
+
+/**
+ * Workers compare against TaskPool::NowMicros(), so the Erlang
+ *  monotonic deadline becomes time remaining now.  Must run on
+ *  the scheduler thread that parsed the options.
+ */
+void
+TaskLimits::Apply(
+    eleveldb::WorkTask * Task) const
+{
+    uint64_t deadline(0);
+
+#ifdef ELEVELDB_DEADLINE
+    if (m_HasDeadline)
+    {
+        long remaining;
+
+        remaining=m_DeadlineMs - (long)enif_monotonic_time(ERL_NIF_MSEC);
+
+        // already expired still needs a nonzero deadline
+        deadline=eleveldb::TaskPool::NowMicros();
+        if (0<remaining)
+            deadline+=(uint64_t)remaining*1000;
+        else
+            deadline-=1;
+    }   // if
+#endif
+
+    if (0!=deadline || NULL!=m_Cancel)
+        Task->SetLimits(deadline, m_Cancel);
+
+}   // TaskLimits::Apply
+
+
+/**
+ * write/3 actions fold into the batch.  Key and value bytes are
+ *  summed here for eleveldb:db_stats/1, leveldb keeps the batch's
+ *  encoded size private.
+ */
+struct BatchBuilder
+{
+    leveldb::WriteBatch & m_Batch;
+    uint64_t m_Bytes;
+
+    explicit BatchBuilder(leveldb::WriteBatch & Batch) : m_Batch(Batch), m_Bytes(0) {};
+};  // struct BatchBuilder
+
+
+ERL_NIF_TERM write_batch_item(ErlNifEnv* env, ERL_NIF_TERM item, BatchBuilder& builder)
 {
+    leveldb::WriteBatch & batch(builder.m_Batch);
+
     int arity;
     const ERL_NIF_TERM* action;
     if (enif_get_tuple(env, item, &arity, &action) ||
@@ -567,6 +974,7 @@ ERL_NIF_TERM write_batch_item(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::WriteB
         if (item == eleveldb::ATOM_CLEAR)
         {
             batch.Clear();
+            builder.m_Bytes=0;
             return eleveldb::ATOM_OK;
         }
 
@@ -579,6 +987,7 @@ ERL_NIF_TERM write_batch_item(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::WriteB
             leveldb::Slice key_slice((const char*)key.data, key.size);
             leveldb::Slice value_slice((const char*)value.data, value.size);
             batch.Put(key_slice, value_slice);
+            builder.m_Bytes+=key.size + value.size;
             return eleveldb::ATOM_OK;
         }
 
@@ -587,6 +996,7 @@ ERL_NIF_TERM write_batch_item(ErlNifEnv* env, ERL_NIF_TERM item, leveldb::WriteB
         {
             leveldb::Slice key_slice((const char*)key.data, key.size);
             batch.Delete(key_slice);
+            builder.m_Bytes+=key.size;
             return eleveldb::ATOM_OK;
         }
     }
@@ -602,16 +1012,53 @@ namespace eleveldb {
 ERL_NIF_TERM send_reply(ErlNifEnv *env, ERL_NIF_TERM ref, ERL_NIF_TERM reply)
 {
     ErlNifPid pid;
-    ErlNifEnv *msg_env = enif_alloc_env();
+    ErlNifEnv *msg_env = eleveldb::EnvPool::Alloc();
     ERL_NIF_TERM msg = enif_make_tuple2(msg_env,
                                         enif_make_copy(msg_env, ref),
                                         enif_make_copy(msg_env, reply));
     enif_self(env, &pid);
     enif_send(env, &pid, msg_env, msg);
-    enif_free_env(msg_env);
+    eleveldb::EnvPool::Free(msg_env);
     return ATOM_OK;
 }
 
+
+/**
+ * Databases opened with {dirty_io, true} run get, write and
+ *  iterator moves on an ERTS dirty I/O scheduler instead of the
+ *  eleveldb thread pool.  The NIF first reschedules itself with
+ *  enif_schedule_nif, the dirty pass then runs the task inline and
+ *  returns the reply instead of sending it.
+ */
+static bool
+on_dirty_io()
+{
+#ifdef ELEVELDB_DIRTY_IO
+    return(ERL_NIF_THR_DIRTY_IO_SCHEDULER==enif_thread_type());
+#else
+    return(false);
+#endif
+}   // on_dirty_io
+
+
+static ERL_NIF_TERM
+run_direct(
+    ErlNifEnv * env,
+    WorkTask * task)
+{
+    ERL_NIF_TERM ret_term;
+
+    task->RefInc();
+
+    basho::async_nif::work_result result(task->RunDirect());
+    ret_term=(result.is_set() ? enif_make_copy(env, result.result()) : ATOM_OK);
+
+    task->RefDec();
+
+    return(ret_term);
+
+}   // run_direct
+
 ERL_NIF_TERM
 async_open(
     ErlNifEnv* env,
@@ -636,36 +1083,19 @@ async_open(
 
     opts->fadvise_willneed = priv.m_Opts.m_FadviseWillNeed;
 
-    // convert total_leveldb_mem to byte count if it arrived as percent
-    //  This happens now because there is no guarantee as to when the total_memory
-    //  value would be read relative to total_leveldb_mem_percent in the option fold
-    uint64_t use_memory;
-
-    // 1. start with all memory
-    use_memory=gCurrentTotalMemory;
+    // one budget for all databases, total_memory may have changed
+    //  with this open
+    priv.m_Governor.SetTotalMemory(gCurrentTotalMemory);
 
-    // 2. valid percentage given
-    if (0 < priv.m_Opts.m_TotalMemPercent && priv.m_Opts.m_TotalMemPercent<=100)
-        use_memory=(priv.m_Opts.m_TotalMemPercent * use_memory)/100;  // integer math for percentage
-
-    // 3. adjust to specific memory size
-    if (0!=priv.m_Opts.m_TotalMem)
-        use_memory=priv.m_Opts.m_TotalMem;
-
-    // 4. fail safe when no guidance given
-    if (0==priv.m_Opts.m_TotalMem && 0==priv.m_Opts.m_TotalMemPercent)
-    {
-        if (8*1024*1024*1024L < gCurrentTotalMemory)
-            use_memory=(gCurrentTotalMemory * 80)/100;  // integer percent
-        else
-            use_memory=(gCurrentTotalMemory * 25)/100;  // integer percent
-    }   // if
-
-    opts->total_leveldb_mem=use_memory;
+    opts->total_leveldb_mem=priv.m_Governor.Budget();
     opts->limited_developer_mem=priv.m_Opts.m_LimitedDeveloper;
 
+    bool dirty_io(false);
+    fold(env, argv[2], parse_dirty_io_option, dirty_io);
+
     eleveldb::WorkTask *work_item = new eleveldb::OpenTask(env, caller_ref,
-                                                              db_name, opts);
+                                                              db_name, opts, dirty_io,
+                                                              &priv.m_Governor);
 
     if(false == priv.thread_pool.Submit(work_item))
     {
@@ -674,6 +1104,8 @@ async_open(
                           enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
     }
 
+    poll_governor(priv);
+
     return eleveldb::ATOM_OK;
 
 }   // async_open
@@ -705,13 +1137,20 @@ async_write(
     if(NULL == db_ptr->m_Db)
         return send_reply(env, caller_ref, error_einval(env));
 
+#ifdef ELEVELDB_DIRTY_IO
+    if (db_ptr->m_DirtyIO && !on_dirty_io())
+        return enif_schedule_nif(env, "async_write", ERL_NIF_DIRTY_JOB_IO_BOUND,
+                                 async_write, argc, argv);
+#endif
+
     eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
 
     // Construct a write batch:
     leveldb::WriteBatch* batch = new leveldb::WriteBatch;
 
     // Seed the batch's data:
-    ERL_NIF_TERM result = fold(env, argv[2], write_batch_item, *batch);
+    BatchBuilder builder(*batch);
+    ERL_NIF_TERM result = fold(env, argv[2], write_batch_item, builder);
     if(eleveldb::ATOM_OK != result)
     {
         // must manually delete batch on failure at this point,
@@ -727,7 +1166,19 @@ async_write(
     fold(env, argv[3], parse_write_option, *opts);
 
     eleveldb::WorkTask* work_item = new eleveldb::WriteTask(env, caller_ref,
-                                                            db_ptr.get(), batch, opts);
+                                                            db_ptr.get(), batch, opts,
+                                                            builder.m_Bytes);
+
+    TaskLimits limits;
+    fold(env, opts_ref, parse_limit_option, limits);
+    limits.Apply(work_item);
+
+    // same {CallerRef, Reply} as the message would have been
+    if (on_dirty_io())
+    {
+        poll_governor(priv);
+        return enif_make_tuple2(env, caller_ref, run_direct(env, work_item));
+    }   // if
 
     if(false == priv.thread_pool.Submit(work_item))
     {
@@ -737,6 +1188,8 @@ async_write(
                           enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
     }   // if
 
+    poll_governor(priv);
+
     return eleveldb::ATOM_OK;
 }
 
@@ -766,14 +1219,31 @@ async_get(
     if(NULL == db_ptr->m_Db)
         return send_reply(env, caller_ref, error_einval(env));
 
+#ifdef ELEVELDB_DIRTY_IO
+    if (db_ptr->m_DirtyIO && !on_dirty_io())
+        return enif_schedule_nif(env, "async_get", ERL_NIF_DIRTY_JOB_IO_BOUND,
+                                 async_get, argc, argv);
+#endif
+
     leveldb::ReadOptions opts;
     fold(env, opts_ref, parse_read_option, opts);
 
     eleveldb::WorkTask *work_item = new eleveldb::GetTask(env, caller_ref,
                                                           db_ptr.get(), key_ref, opts);
 
+    TaskLimits limits;
+    fold(env, opts_ref, parse_limit_option, limits);
+    limits.Apply(work_item);
+
     eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
 
+    // same {CallerRef, Reply} as the message would have been
+    if (on_dirty_io())
+    {
+        poll_governor(priv);
+        return enif_make_tuple2(env, caller_ref, run_direct(env, work_item));
+    }   // if
+
     if(false == priv.thread_pool.Submit(work_item))
     {
         delete work_item;
@@ -781,6 +1251,8 @@ async_get(
                           enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
     }   // if
 
+    poll_governor(priv);
+
     return eleveldb::ATOM_OK;
 
 }   // async_get
@@ -816,8 +1288,38 @@ async_iterator(
     leveldb::ReadOptions opts;
     fold(env, options_ref, parse_read_option, opts);
 
+    IteratorOptions itr_opts;
+    fold(env, options_ref, parse_iterator_option, itr_opts);
+
+    // a refresh policy is pointless without refresh
+    if (itr_opts.m_RefreshPolicy)
+        opts.iterator_refresh = true;
+
+    // without a snapshot, the leveldb iterator still holds its Version
+    //  (and so its .sst files) until rebuilt.  Rebuild often unless
+    //  caller chose a policy.
+    if (itr_opts.m_NoSnapshot)
+    {
+        opts.iterator_refresh = true;
+        if (!itr_opts.m_RefreshPolicy)
+        {
+            itr_opts.m_RefreshInterval = 10;
+            itr_opts.m_RefreshMoves = 10000;
+        }   // if
+    }   // if
+
+    // sequential scan: keep bulk data out of block cache and let the
+    //  prefetch ring read ahead of Erlang (unless caller sized it)
+    if (itr_opts.m_Sequential)
+    {
+        opts.fill_cache = false;
+        if (itr_opts.m_PrefetchDepth <= 1)
+            itr_opts.m_PrefetchDepth = 64;
+    }   // if
+
     eleveldb::WorkTask *work_item = new eleveldb::IterTask(env, caller_ref,
-                                                           db_ptr.get(), keys_only, opts);
+                                                           db_ptr.get(), keys_only,
+                                                           opts, itr_opts);
 
     // Now-boilerplate setup (we'll consolidate this pattern soon, I hope):
     eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
@@ -828,38 +1330,28 @@ async_iterator(
         return send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
     }   // if
 
+    poll_governor(priv);
+
     return ATOM_OK;
 
 }   // async_iterator
 
 
-ERL_NIF_TERM
-async_iterator_move(
+/**
+ * Translate iterator_move's action term.  A term that is not an atom
+ *  or {packed, Count} tuple is a seek target.  Returns false for a
+ *  malformed {packed, Count}.
+ */
+static bool
+parse_move_action(
     ErlNifEnv* env,
-    int argc,
-    const ERL_NIF_TERM argv[])
+    const ERL_NIF_TERM& action_or_target,
+    eleveldb::MoveTask::action_t& action,
+    size_t& packed_count)
 {
-    // const ERL_NIF_TERM& caller_ref       = argv[0];
-    const ERL_NIF_TERM& itr_handle_ref   = argv[1];
-    const ERL_NIF_TERM& action_or_target = argv[2];
-    ERL_NIF_TERM ret_term;
-
-    bool submit_new_request(true);
-    int prefetch_state;      // not bool for Solaris CAS
-
-    ReferencePtr<ItrObject> itr_ptr;
-
-    itr_ptr.assign(ItrObject::RetrieveItrObject(env, itr_handle_ref));
-
-    if(NULL==itr_ptr.get() || 0!=itr_ptr->GetCloseRequested())
-        return enif_make_badarg(env);
-
-    // Reuse ref from iterator creation
-    const ERL_NIF_TERM& caller_ref = itr_ptr->itr_ref;
-
     /* We can be invoked with two different arities from Erlang. If our "action_atom" parameter is not
        in fact an atom, then it is actually a seek target. Let's find out which we are: */
-    eleveldb::MoveTask::action_t action = eleveldb::MoveTask::SEEK;
+    action = eleveldb::MoveTask::SEEK;
 
     // If we have an atom, it's one of these (action_or_target's value is ignored):
     if(enif_is_atom(env, action_or_target))
@@ -870,69 +1362,267 @@ async_iterator_move(
         if(ATOM_PREV == action_or_target)   action = eleveldb::MoveTask::PREV;
         if(ATOM_PREFETCH == action_or_target)   action = eleveldb::MoveTask::PREFETCH;
         if(ATOM_PREFETCH_STOP == action_or_target)   action = eleveldb::MoveTask::PREFETCH_STOP;
+        if(ATOM_CONTINUATION == action_or_target)   action = eleveldb::MoveTask::CONTINUATION;
     }   // if
 
-    // debug syslog(LOG_ERR, "move state: %d, %d, %d",
-    //              action, itr_ptr->m_Iter->m_PrefetchStarted, itr_ptr->m_Iter->m_HandoffAtomic);
+    // {packed, Count} returns up to Count entries in one binary
+    else if (enif_is_tuple(env, action_or_target))
+    {
+        int arity;
+        const ERL_NIF_TERM * packed;
+        unsigned long count;
 
-    // must set this BEFORE call to compare_and_swap ... or have potential
-    //  for an "extra" message coming out of prefetch
-    prefetch_state = itr_ptr->m_Iter->m_PrefetchStarted;
-    itr_ptr->m_Iter->m_PrefetchStarted =  prefetch_state && (eleveldb::MoveTask::PREFETCH_STOP != action );
+        if (!enif_get_tuple(env, action_or_target, &arity, &packed) || 2!=arity
+            || ATOM_PACKED!=packed[0] || !enif_get_ulong(env, packed[1], &count)
+            || 0==count)
+            return(false);
 
-    //
-    // Three situations:
-    //  #1 not a PREFETCH next call
-    //  #2 PREFETCH call and no prefetch waiting
-    //  #3 PREFETCH call and prefetch is waiting
-    //     (PREFETCH_STOP is basically a PREFETCH that turns off prefetch state)
+        action = eleveldb::MoveTask::PACKED;
+        packed_count = count;
+    }   // else if
 
-    // case #1
-    if (eleveldb::MoveTask::PREFETCH != action
-        && eleveldb::MoveTask::PREFETCH_STOP != action )
-    {
-        // current move object could still be in later stages of
-        //  worker thread completion ... race condition ...don't reuse
-        itr_ptr->ReleaseReuseMove();
+    return(true);
 
-        submit_new_request=true;
-        ret_term = enif_make_copy(env, itr_ptr->itr_ref);
+}   // parse_move_action
 
-        // force reply to be a message
-        itr_ptr->m_Iter->m_HandoffAtomic=1;
-        itr_ptr->m_Iter->m_PrefetchStarted=false;
-    }   // if
 
-    // case #2
-    // before we launch a background job for "next iteration", see if there is a
-    //  prefetch waiting for us
-    else if (leveldb::compare_and_swap(&itr_ptr->m_Iter->m_HandoffAtomic, 0, 1))
-    {
-        // nope, no prefetch ... await a message to erlang queue
-        //  NOTE:  "else" clause of MoveTask::DoWork() could be running simultaneously
-        ret_term = enif_make_copy(env, itr_ptr->itr_ref);
+/**
+ * Erlang side of the prefetch ring (see MoveTask::FillRing for
+ *  worker side).  Returns true if caller must submit a MoveTask,
+ *  m_RingWorker is already claimed for it.  ret_term is either the
+ *  reply or the iterator's reference when reply comes by message.
+ */
+static bool
+ring_iterator_move(
+    ErlNifEnv* env,
+    ItrObject * itr_ptr,
+    LevelIteratorWrapper * wrap,
+    MoveTask::action_t action,
+    ERL_NIF_TERM & ret_term)
+{
+    bool submit(false), waiting(false);
 
-        // leave m_HandoffAtomic as 1 so first response is via message
+    ret_term = enif_make_copy(env, itr_ptr->itr_ref);
 
-        // is this truly a wait for prefetch ... or actually the first prefetch request
-        if (!prefetch_state)
+    if (MoveTask::PREFETCH == action)
+    {
+        // set m_RingWaiting BEFORE looking at ring and m_RingWorker,
+        //  worker releases m_RingWorker BEFORE looking at m_RingWaiting
+        if (wrap->m_Ring.IsEmpty())
+            waiting=leveldb::compare_and_swap(&wrap->m_RingWaiting, 0, 1);
+
+        if (!wrap->m_Ring.IsEmpty())
         {
-            submit_new_request=true;
-            itr_ptr->ReleaseReuseMove();
+            // only one reply per request, worker might
+            //  have taken the wait between the two tests
+            if (!waiting || leveldb::compare_and_swap(&wrap->m_RingWaiting, 1, 0))
+            {
+                ret_term=wrap->RingReply(env, false);
+
+                // restart worker once ring half drained, not
+                //  once per entry
+                if (!wrap->RingFinished()
+                    && wrap->m_Ring.Count() <= wrap->m_Ring.Depth()/2)
+                    submit=wrap->RingClaim();
+            }   // if
+        }   // if
+
+        else if (wrap->RingFinished())
+        {
+            // RingReply resets the ring for invalid_iterator, must own it
+            if (wrap->RingClaim())
+            {
+                if (leveldb::compare_and_swap(&wrap->m_RingWaiting, 1, 0))
+                    ret_term=wrap->RingReply(env, false);
+                wrap->RingRelease();
+            }   // if
+        }   // else if
+
+        // no worker active, start one that answers this request
+        else
+        {
+            submit=wrap->RingClaim();
+
+            // worker already reading ahead, this request outran it
+            if (!submit)
+                wrap->m_DbPtr->m_Counters.Add(eleveldb::eDbStalls);
+        }   // else
+    }   // if
+
+    // PREFETCH_STOP
+    else
+    {
+        leveldb::compare_and_swap(&wrap->m_RingStop, 0, 1);
+        leveldb::compare_and_swap(&wrap->m_RingWaiting, 0, 2);
+
+        // active worker answers at its end, otherwise answer here
+        if (wrap->RingClaim())
+        {
+            if (leveldb::compare_and_swap(&wrap->m_RingWaiting, 2, 0))
+            {
+                if (!wrap->m_Ring.IsEmpty() || wrap->RingFinished())
+                {
+                    ret_term=wrap->RingReply(env, true);
+                    wrap->RingRelease();
+                }   // if
+
+                // nothing read ahead, worker must read "next"
+                else
+                {
+                    leveldb::compare_and_swap(&wrap->m_RingWaiting, 0, 2);
+                    submit=true;
+                }   // else
+            }   // if
+            else
+            {
+                wrap->RingRelease();
+            }   // else
+        }   // if
+    }   // else
+
+    return(submit);
+
+}   // ring_iterator_move
+
+
+ERL_NIF_TERM
+async_iterator_move(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    // const ERL_NIF_TERM& caller_ref       = argv[0];
+    const ERL_NIF_TERM& itr_handle_ref   = argv[1];
+    const ERL_NIF_TERM& action_or_target = argv[2];
+    ERL_NIF_TERM ret_term;
+
+    bool submit_new_request(true);
+    int prefetch_state;      // not bool for Solaris CAS
+    size_t packed_count(0);
+
+    ReferencePtr<ItrObject> itr_ptr;
+    ReferencePtr<LevelIteratorWrapper> wrap;
+
+    itr_ptr.assign(ItrObject::RetrieveItrObject(env, itr_handle_ref));
+
+    if(NULL==itr_ptr.get() || 0!=itr_ptr->GetCloseRequested())
+        return enif_make_badarg(env);
+
+    // idle close (DbObject::CloseIdleIterators) can release m_Iter on
+    //  a worker thread after the test above
+    if (!itr_ptr->HoldIterator(wrap))
+        return enif_make_tuple2(env, eleveldb::ATOM_ERROR, eleveldb::ATOM_ITERATOR_CLOSED);
+
+    // Reuse ref from iterator creation
+    const ERL_NIF_TERM& caller_ref = itr_ptr->itr_ref;
+
+    eleveldb::MoveTask::action_t action;
+
+    if (!parse_move_action(env, action_or_target, action, packed_count))
+        return enif_make_badarg(env);
+
+    // queued moves own the leveldb iterator until their last reply
+    if (wrap->QueueActive())
+        return enif_make_tuple2(env, eleveldb::ATOM_ERROR, eleveldb::ATOM_BUSY);
+
+#ifdef ELEVELDB_DIRTY_IO
+    // prefetch depends on a worker running ahead of Erlang, stays on thread pool
+    if (itr_ptr->m_DbPtr->m_DirtyIO && !on_dirty_io()
+        && eleveldb::MoveTask::PREFETCH != action
+        && eleveldb::MoveTask::PREFETCH_STOP != action)
+        return enif_schedule_nif(env, "async_iterator_move", ERL_NIF_DIRTY_JOB_IO_BOUND,
+                                 async_iterator_move, argc, argv);
+#endif
+
+    // fold-only traffic must still trigger rebalances, ring hits submit no task
+    poll_governor(*static_cast<eleveldb_priv_data *>(enif_priv_data(env)));
+
+    // debug syslog(LOG_ERR, "move state: %d, %d, %d",
+    //              action, wrap->m_PrefetchStarted, wrap->m_HandoffAtomic);
+
+    // must set this BEFORE call to compare_and_swap ... or have potential
+    //  for an "extra" message coming out of prefetch
+    prefetch_state = wrap->m_PrefetchStarted;
+    wrap->m_PrefetchStarted =  prefetch_state && (eleveldb::MoveTask::PREFETCH_STOP != action );
+
+    //
+    // Four situations:
+    //  #0 PREFETCH call on iterator with prefetch ring (prefetch_depth option)
+    //  #1 not a PREFETCH next call
+    //  #2 PREFETCH call and no prefetch waiting
+    //  #3 PREFETCH call and prefetch is waiting
+    //     (PREFETCH_STOP is basically a PREFETCH that turns off prefetch state)
+
+    // case #0
+    if (1<wrap->m_Ring.Depth()
+        && (eleveldb::MoveTask::PREFETCH == action
+            || eleveldb::MoveTask::PREFETCH_STOP == action))
+    {
+        submit_new_request=ring_iterator_move(env, itr_ptr.get(), wrap.get(), action, ret_term);
+
+        if (submit_new_request)
+            itr_ptr->ReleaseReuseMove();
+    }   // if
+
+    // case #1
+    else if (eleveldb::MoveTask::PREFETCH != action
+        && eleveldb::MoveTask::PREFETCH_STOP != action )
+    {
+        // abandon any partial prefetch ring sequence, but a worker still
+        //  reading ahead owns the leveldb iterator until the ring is full,
+        //  keys end or prefetch_stop
+        if (1<wrap->m_Ring.Depth())
+        {
+            if (!wrap->RingClaim())
+                return enif_make_tuple2(env, eleveldb::ATOM_ERROR, eleveldb::ATOM_BUSY);
+
+            wrap->RingReset();
+            wrap->RingRelease();
+        }   // if
+
+        // current move object could still be in later stages of
+        //  worker thread completion ... race condition ...don't reuse
+        itr_ptr->ReleaseReuseMove();
+
+        submit_new_request=true;
+        ret_term = enif_make_copy(env, itr_ptr->itr_ref);
+
+        // force reply to be a message
+        wrap->m_HandoffAtomic=1;
+        wrap->m_PrefetchStarted=false;
+    }   // if
+
+    // case #2
+    // before we launch a background job for "next iteration", see if there is a
+    //  prefetch waiting for us
+    else if (leveldb::compare_and_swap(&wrap->m_HandoffAtomic, 0, 1))
+    {
+        // nope, no prefetch ... await a message to erlang queue
+        //  NOTE:  "else" clause of MoveTask::DoWork() could be running simultaneously
+        ret_term = enif_make_copy(env, itr_ptr->itr_ref);
+
+        // leave m_HandoffAtomic as 1 so first response is via message
+
+        // is this truly a wait for prefetch ... or actually the first prefetch request
+        if (!prefetch_state)
+        {
+            submit_new_request=true;
+            itr_ptr->ReleaseReuseMove();
         }   // if
 
         else
         {
             // await message that is already in the making
             submit_new_request=false;
+            wrap->m_DbPtr->m_Counters.Add(eleveldb::eDbStalls);
         }   // else
 
         // using compare_and_swap has a hardware locking "set only if still in same state as before"
         //  (this is an absolute must since worker thread could change to false if
         //   hits end of key space and its execution overlaps this block's execution)
         int cas_temp((eleveldb::MoveTask::PREFETCH_STOP != action )  // needed for Solaris CAS
-                     && itr_ptr->m_Iter->Valid());
-        leveldb::compare_and_swap(&itr_ptr->m_Iter->m_PrefetchStarted,
+                     && wrap->Valid());
+        leveldb::compare_and_swap(&wrap->m_PrefetchStarted,
                                   prefetch_state,
                                   cas_temp);
     }   // else if
@@ -943,261 +1633,1141 @@ async_iterator_move(
         // why yes there is.  copy the key/value info into a return tuple before
         //  we launch the iterator for "next" again
         //  NOTE:  worker thread is inactive at this time
-        if(!itr_ptr->m_Iter->Valid())
+        if(!wrap->Valid())
             ret_term=enif_make_tuple2(env, ATOM_ERROR, ATOM_INVALID_ITERATOR);
 
-        else if (itr_ptr->m_Iter->m_KeysOnly)
-            ret_term=enif_make_tuple2(env, ATOM_OK, slice_to_binary(env, itr_ptr->m_Iter->key()));
-        else
-            ret_term=enif_make_tuple3(env, ATOM_OK,
-                                      slice_to_binary(env, itr_ptr->m_Iter->key()),
-                                      slice_to_binary(env, itr_ptr->m_Iter->value()));
+        else if (wrap->m_KeysOnly)
+            ret_term=enif_make_tuple2(env, ATOM_OK, slice_to_binary(env, wrap->key()));
+        else
+            ret_term=enif_make_tuple3(env, ATOM_OK,
+                                      slice_to_binary(env, wrap->key()),
+                                      slice_to_binary(env, wrap->value()));
+
+
+        // reset for next race
+        wrap->m_HandoffAtomic=0;
+
+        // old MoveItem could still be active on its thread, cannot
+        //  reuse ... but the current Iterator is good
+        itr_ptr->ReleaseReuseMove();
+
+        if (eleveldb::MoveTask::PREFETCH_STOP != action
+            && wrap->Valid())
+        {
+            submit_new_request=true;
+        }   // if
+        else
+        {
+            submit_new_request=false;
+            wrap->m_HandoffAtomic=0;
+            wrap->m_PrefetchStarted=false;
+        }   // else
+
+
+    }   // else
+
+
+    // only build request if actually need to submit it
+    if (submit_new_request)
+    {
+        eleveldb::MoveTask * move_item;
+
+        bool direct(on_dirty_io());
+
+        move_item = new eleveldb::MoveTask(env, caller_ref,
+                                           wrap.get(), action);
+
+        // prevent deletes during worker loop
+        if (!direct)
+        {
+            move_item->RefInc();
+            itr_ptr->reuse_move=move_item;
+        }   // if
+
+        move_item->action=action;
+        move_item->packed_count=packed_count;
+
+        // iterator_move/3 options, prefetch work resubmits itself and has no limits
+        if (4==argc && eleveldb::MoveTask::PREFETCH != action
+            && eleveldb::MoveTask::PREFETCH_STOP != action)
+        {
+            TaskLimits limits;
+            fold(env, argv[3], parse_limit_option, limits);
+            limits.Apply(move_item);
+        }   // if
+
+        if (eleveldb::MoveTask::SEEK == action)
+        {
+            ErlNifBinary key;
+
+            if(!enif_inspect_binary(env, action_or_target, &key))
+            {
+                if (direct)
+                    delete move_item;
+                itr_ptr->ReleaseReuseMove();
+                itr_ptr->reuse_move=NULL;
+                return enif_make_tuple2(env, ATOM_EINVAL, caller_ref);
+            }   // if
+
+            move_item->seek_target.assign((const char *)key.data, key.size);
+        }   // else
+
+        // reply is the return value, iterator_move accepts it directly
+        if (direct)
+            return(run_direct(env, move_item));
+
+        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+        if(false == priv.thread_pool.Submit(move_item))
+        {
+            itr_ptr->ReleaseReuseMove();
+            itr_ptr->reuse_move=NULL;
+
+            // ring_iterator_move claimed the ring for this move
+            if (1<wrap->m_Ring.Depth())
+            {
+                wrap->RingReset();
+                wrap->RingRelease();
+            }   // if
+
+            return enif_make_tuple2(env, ATOM_ERROR, caller_ref);
+        }   // if
+    }   // if
+
+    return ret_term;
+
+}   // async_iter_move
+
+
+/**
+ * Queue a move on the iterator without waiting for earlier ones.
+ *  Queued moves execute in order on one worker thread and each
+ *  replies {ItrRef, RequestId, Reply}.  Returns {ItrRef, RequestId}.
+ *  Prefetch actions are not queueable.  {error, busy} while a
+ *  prefetch or direct move still owns the leveldb iterator.
+ */
+ERL_NIF_TERM
+async_iterator_queue_move(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    const ERL_NIF_TERM& itr_handle_ref   = argv[0];
+    const ERL_NIF_TERM& action_or_target = argv[1];
+
+    ReferencePtr<ItrObject> itr_ptr;
+    eleveldb::MoveTask::action_t action;
+    eleveldb::QueuedMove move;
+
+    itr_ptr.assign(ItrObject::RetrieveItrObject(env, itr_handle_ref));
+
+    if(NULL==itr_ptr.get() || 0!=itr_ptr->GetCloseRequested())
+        return enif_make_badarg(env);
+
+    if (!parse_move_action(env, action_or_target, action, move.m_Count)
+        || eleveldb::MoveTask::PREFETCH == action
+        || eleveldb::MoveTask::PREFETCH_STOP == action)
+        return enif_make_badarg(env);
+
+    if (eleveldb::MoveTask::SEEK == action)
+    {
+        ErlNifBinary key;
+
+        if(!enif_inspect_binary(env, action_or_target, &key))
+            return enif_make_badarg(env);
+
+        move.m_Target.assign((const char *)key.data, key.size);
+    }   // if
+
+    move.m_Action=action;
+    enif_self(env, &move.m_Pid);
+
+    // Reuse ref from iterator creation
+    const ERL_NIF_TERM& caller_ref = itr_ptr->itr_ref;
+    ReferencePtr<LevelIteratorWrapper> wrap;
+
+    if (!itr_ptr->HoldIterator(wrap))
+        return enif_make_tuple2(env, ATOM_ERROR, ATOM_ITERATOR_CLOSED);
+
+    // queued moves serialize among themselves, but not with a
+    //  prefetch or direct move still using the leveldb iterator
+    if (!wrap->QueueActive() && wrap->MoveBusy())
+        return enif_make_tuple2(env, ATOM_ERROR, ATOM_BUSY);
+
+    if (wrap->QueuePush(move))
+    {
+        eleveldb::QueueMoveTask * work_item;
+
+        work_item = new eleveldb::QueueMoveTask(env, caller_ref, wrap.get(), action);
+
+        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+        if(false == priv.thread_pool.Submit(work_item))
+        {
+            delete work_item;
+            wrap->QueueAbort();
+            return enif_make_tuple2(env, ATOM_ERROR, caller_ref);
+        }   // if
+    }   // if
+
+    return enif_make_tuple2(env, enif_make_copy(env, caller_ref),
+                            enif_make_ulong(env, move.m_Id));
+
+}   // async_iterator_queue_move
+
+
+ERL_NIF_TERM
+async_close(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    const ERL_NIF_TERM& caller_ref  = argv[0];
+    const ERL_NIF_TERM& dbh_ref     = argv[1];
+    bool term_ok=false;
+
+    ReferencePtr<DbObject> db_ptr;
+
+    db_ptr.assign(DbObject::RetrieveDbObject(env, dbh_ref, &term_ok));
+
+    if(NULL==db_ptr.get() || 0!=db_ptr->GetCloseRequested())
+    {
+       return enif_make_badarg(env);
+    }
+
+    // verify that Erlang has not called DbObjectResourceCleanup
+    //  already (that would be bad)
+    if (NULL!=db_ptr->m_Db
+//        && compare_and_swap(db_ptr->m_ErlangThisPtr, db_ptr.get(), (DbObject *)NULL))
+        && db_ptr->ClaimCloseFromCThread())
+    {
+        eleveldb::WorkTask *work_item = new eleveldb::CloseTask(env, caller_ref,
+                                                                db_ptr.get());
+
+        // Now-boilerplate setup (we'll consolidate this pattern soon, I hope):
+        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+        if(false == priv.thread_pool.Submit(work_item))
+        {
+            delete work_item;
+            return send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
+        }   // if
+    }   // if
+    else if (!term_ok)
+    {
+        return send_reply(env, caller_ref, error_einval(env));
+    }   // else
+
+    return ATOM_OK;
+
+}  // async_close
+
+
+ERL_NIF_TERM
+async_iterator_close(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    const ERL_NIF_TERM& caller_ref  = argv[0];
+    const ERL_NIF_TERM& itr_ref     = argv[1];
+
+    ReferencePtr<ItrObject> itr_ptr;
+
+    itr_ptr.assign(ItrObject::RetrieveItrObject(env, itr_ref));
+
+    if(NULL==itr_ptr.get() || 0!=itr_ptr->GetCloseRequested())
+    {
+       leveldb::gPerfCounters->Inc(leveldb::ePerfDebug4);
+       return enif_make_badarg(env);
+    }
+
+    // verify that Erlang has not called ItrObjectResourceCleanup AND
+    //  that a database close has not already started death proceedings
+    if (itr_ptr->ClaimCloseFromCThread())
+    {
+        eleveldb::WorkTask *work_item = new eleveldb::ItrCloseTask(env, caller_ref,
+                                                                   itr_ptr.get());
+
+        // Now-boilerplate setup (we'll consolidate this pattern soon, I hope):
+        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+        if(false == priv.thread_pool.Submit(work_item))
+        {
+            delete work_item;
+            return send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
+        }   // if
+    }   // if
+
+    // this close/cleanup call is way late ... bad programmer!
+    else
+    {
+        return send_reply(env, caller_ref, error_einval(env));
+    }   // else
+
+    return ATOM_OK;
+
+}   // async_iterator_close
+
+
+ERL_NIF_TERM
+async_merge_iterator(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    const ERL_NIF_TERM& caller_ref  = argv[0];
+    const ERL_NIF_TERM& db_list     = argv[1];
+    const ERL_NIF_TERM& options_ref = argv[2];
+
+    const bool keys_only = ((argc == 4) && (argv[3] == ATOM_KEYS_ONLY));
+
+    std::vector<DbObject *> dbs;
+    std::vector<DbObject *>::iterator it;
+    ERL_NIF_TERM head, tail, ret_term;
+    bool good;
+
+    good=enif_is_list(env, db_list) && enif_is_list(env, options_ref);
+
+    // hold each database while building the task, task takes its own references
+    for (tail=db_list; good && enif_get_list_cell(env, tail, &head, &tail); )
+    {
+        DbObject * db_ptr(DbObject::RetrieveDbObject(env, head));
+
+        if (NULL==db_ptr || 0!=db_ptr->GetCloseRequested() || NULL==db_ptr->m_Db)
+        {
+            good=false;
+        }   // if
+        else
+        {
+            db_ptr->RefInc();
+            dbs.push_back(db_ptr);
+        }   // else
+    }   // for
+
+    if (good && !dbs.empty())
+    {
+        leveldb::ReadOptions opts;
+        fold(env, options_ref, parse_read_option, opts);
+
+        IteratorOptions parsed_opts, itr_opts;
+        fold(env, options_ref, parse_iterator_option, parsed_opts);
+
+        // merge steps the leveldb iterators directly:  no prefetch
+        //  ring, no iterator_refresh
+        opts.iterator_refresh = false;
+        if (parsed_opts.m_Sequential)
+        {
+            opts.fill_cache = false;
+            itr_opts.m_Sequential = true;
+        }   // if
+
+        eleveldb::WorkTask *work_item = new eleveldb::MergeIterTask(env, caller_ref, dbs,
+                                                                    keys_only, opts, itr_opts);
+
+        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+        if(false == priv.thread_pool.Submit(work_item))
+        {
+            delete work_item;
+            ret_term=send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
+        }   // if
+        else
+        {
+            ret_term=ATOM_OK;
+        }   // else
+    }   // if
+    else
+    {
+        ret_term=enif_make_badarg(env);
+    }   // else
+
+    for (it=dbs.begin(); dbs.end()!=it; ++it)
+        (*it)->RefDec();
+
+    return ret_term;
+
+}   // async_merge_iterator
+
+
+ERL_NIF_TERM
+async_merge_iterator_move(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    const ERL_NIF_TERM& caller_ref       = argv[0];
+    const ERL_NIF_TERM& merge_handle_ref = argv[1];
+    const ERL_NIF_TERM& action_or_target = argv[2];
+    const ERL_NIF_TERM& batch_ref        = argv[3];
+
+    MergeItrObject * merge_ptr;
+    eleveldb::MergeMoveTask::action_t action;
+    std::string seek_target;
+    unsigned long batch;
+    ErlNifBinary key;
+
+    merge_ptr=MergeItrObject::RetrieveMergeItrObject(env, merge_handle_ref);
+
+    if (NULL==merge_ptr || !enif_get_ulong(env, batch_ref, &batch) || 0==batch)
+        return enif_make_badarg(env);
+
+    if (ATOM_FIRST == action_or_target)
+        action=eleveldb::MergeMoveTask::FIRST;
+    else if (ATOM_NEXT == action_or_target)
+        action=eleveldb::MergeMoveTask::NEXT;
+    else if (enif_inspect_binary(env, action_or_target, &key))
+    {
+        action=eleveldb::MergeMoveTask::SEEK;
+        seek_target.assign((const char *)key.data, key.size);
+    }   // else if
+    else
+        return enif_make_badarg(env);
+
+    eleveldb::WorkTask *work_item = new eleveldb::MergeMoveTask(env, caller_ref, merge_ptr,
+                                                                action, seek_target, batch);
+
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+    if(false == priv.thread_pool.Submit(work_item))
+    {
+        delete work_item;
+        return send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
+    }   // if
+
+    return ATOM_OK;
+
+}   // async_merge_iterator_move
+
+
+ERL_NIF_TERM
+async_merge_iterator_close(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    const ERL_NIF_TERM& caller_ref       = argv[0];
+    const ERL_NIF_TERM& merge_handle_ref = argv[1];
+
+    MergeItrObject * merge_ptr;
+
+    merge_ptr=MergeItrObject::RetrieveMergeItrObject(env, merge_handle_ref);
+
+    if (NULL==merge_ptr)
+        return enif_make_badarg(env);
+
+    eleveldb::WorkTask *work_item = new eleveldb::MergeMoveTask(env, caller_ref, merge_ptr,
+                                                                eleveldb::MergeMoveTask::CLOSE,
+                                                                std::string(), 0);
+
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+    if(false == priv.thread_pool.Submit(work_item))
+    {
+        delete work_item;
+        return send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
+    }   // if
+
+    return ATOM_OK;
+
+}   // async_merge_iterator_close
+
+
+ERL_NIF_TERM
+async_destroy(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    char db_name[4096];
+
+    if(!enif_get_string(env, argv[1], db_name, sizeof(db_name), ERL_NIF_LATIN1) ||
+       !enif_is_list(env, argv[2]))
+    {
+        return enif_make_badarg(env);
+    }   // if
+
+    ERL_NIF_TERM caller_ref = argv[0];
+
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+    leveldb::Options *opts = new leveldb::Options;
+    fold(env, argv[2], parse_open_option, *opts);
+
+    eleveldb::WorkTask *work_item = new eleveldb::DestroyTask(env, caller_ref,
+                                                              db_name, opts);
+
+    if(false == priv.thread_pool.Submit(work_item))
+    {
+        delete work_item;
+        return send_reply(env, caller_ref,
+                          enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
+    }
+
+    return eleveldb::ATOM_OK;
+
+}   // async_destroy
+
+
+/**
+ * leveldb::RepairDB() on an admin class thread, progress messages
+ *  are sent to the caller until the final reply.
+ */
+ERL_NIF_TERM
+async_repair(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    char db_name[4096];
+
+    if(!enif_get_string(env, argv[1], db_name, sizeof(db_name), ERL_NIF_LATIN1) ||
+       !enif_is_list(env, argv[2]))
+    {
+        return enif_make_badarg(env);
+    }   // if
+
+    ERL_NIF_TERM caller_ref = argv[0];
+
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+    leveldb::Options opts;
+    fold(env, argv[2], parse_open_option, opts);
+
+    eleveldb::WorkTask *work_item = new eleveldb::RepairTask(env, caller_ref,
+                                                             db_name, opts);
+
+    if(false == priv.thread_pool.Submit(work_item))
+    {
+        delete work_item;
+        return send_reply(env, caller_ref,
+                          enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
+    }
+
+    return eleveldb::ATOM_OK;
+
+}   // async_repair
+
+
+/**
+ * Give back Fraction (0.0 to 1.0) of the memory budget, 0 restores
+ *  the full budget.  Reply {ok, ReclaimedBytes}.
+ */
+ERL_NIF_TERM
+async_shrink_caches(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    ERL_NIF_TERM caller_ref = argv[0];
+    double fraction;
+    long whole;
+
+    if (enif_get_long(env, argv[1], &whole))
+        fraction=(double)whole;
+    else if (!enif_get_double(env, argv[1], &fraction))
+        return enif_make_badarg(env);
+
+    if (fraction<0.0 || 1.0<fraction)
+        return enif_make_badarg(env);
+
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+    eleveldb::WorkTask *work_item = new eleveldb::ShrinkTask(env, caller_ref, &priv.m_Governor,
+                                                             (uint32_t)(fraction * 100.0 + 0.5));
+
+    if(false == priv.thread_pool.Submit(work_item))
+    {
+        delete work_item;
+        return send_reply(env, caller_ref,
+                          enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
+    }
+
+    return eleveldb::ATOM_OK;
+
+}   // async_shrink_caches
+
+
+/**
+ * Close the database's iterators idle IdleSeconds or more now,
+ *  same as iterator_idle_close does on each memory rebalance.
+ *  Reply {ok, Closed}.
+ */
+ERL_NIF_TERM
+async_close_idle_iterators(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    ERL_NIF_TERM caller_ref = argv[0];
+    const ERL_NIF_TERM& dbh_ref = argv[1];
+    unsigned idle_seconds;
+
+    ReferencePtr<DbObject> db_ptr;
+
+    db_ptr.assign(DbObject::RetrieveDbObject(env, dbh_ref));
+
+    if(NULL==db_ptr.get() || !enif_get_uint(env, argv[2], &idle_seconds))
+        return enif_make_badarg(env);
+
+    if(NULL == db_ptr->m_Db)
+        return send_reply(env, caller_ref, error_einval(env));
+
+    eleveldb::WorkTask *work_item = new eleveldb::IdleCloseTask(env, caller_ref,
+                                                                db_ptr.get(), idle_seconds);
+
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+    if(false == priv.thread_pool.Submit(work_item))
+    {
+        delete work_item;
+        return send_reply(env, caller_ref,
+                          enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
+    }
+
+    return eleveldb::ATOM_OK;
+
+}   // async_close_idle_iterators
+
+
+/**
+ * Status property query on a worker thread.  Key is one binary,
+ *  reply {ok, Value} | error, or a list of binaries, reply a list
+ *  of {Key, {ok, Value} | error} in the same order.
+ */
+ERL_NIF_TERM
+async_status(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    ERL_NIF_TERM caller_ref = argv[0];
+    const ERL_NIF_TERM& dbh_ref  = argv[1];
+    const ERL_NIF_TERM& name_ref = argv[2];
+
+    ReferencePtr<DbObject> db_ptr;
+    bool good_names(enif_is_binary(env, name_ref));
+
+    db_ptr.assign(DbObject::RetrieveDbObject(env, dbh_ref));
+
+    if (!good_names && enif_is_list(env, name_ref))
+    {
+        ERL_NIF_TERM head, tail;
+
+        good_names=true;
+        for (tail=name_ref; good_names && enif_get_list_cell(env, tail, &head, &tail); )
+            good_names=enif_is_binary(env, head);
+    }   // if
+
+    if(NULL==db_ptr.get() || !good_names)
+    {
+        return enif_make_badarg(env);
+    }
+
+    if(NULL == db_ptr->m_Db)
+        return send_reply(env, caller_ref, error_einval(env));
+
+    eleveldb::WorkTask *work_item = new eleveldb::StatusTask(env, caller_ref,
+                                                             db_ptr.get(), name_ref);
+
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+
+    if(false == priv.thread_pool.Submit(work_item))
+    {
+        delete work_item;
+        return send_reply(env, caller_ref,
+                          enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
+    }   // if
+
+    return eleveldb::ATOM_OK;
+
+}   // async_status
+
+} // namespace eleveldb
+
+
+/**
+ * Synchronous property query, runs on the calling scheduler.
+ *  eleveldb:status/2 uses async_status instead.
+ */
+ERL_NIF_TERM
+eleveldb_status(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    ErlNifBinary name_bin;
+    eleveldb::ReferencePtr<eleveldb::DbObject> db_ptr;
+
+    db_ptr.assign(eleveldb::DbObject::RetrieveDbObject(env, argv[0]));
+
+    if(NULL!=db_ptr.get()
+       && enif_inspect_binary(env, argv[1], &name_bin))
+    {
+        if (db_ptr->m_Db == NULL)
+        {
+            return error_einval(env);
+        }
+
+        leveldb::Slice name((const char*)name_bin.data, name_bin.size);
+        std::string value;
+        if (db_ptr->GetProperty(name, &value))
+        {
+            ERL_NIF_TERM result;
+            unsigned char* result_buf = enif_make_new_binary(env, value.size(), &result);
+            memcpy(result_buf, value.c_str(), value.size());
+
+            return enif_make_tuple2(env, eleveldb::ATOM_OK, result);
+        }
+        else
+        {
+            return eleveldb::ATOM_ERROR;
+        }
+    }
+    else
+    {
+        return enif_make_badarg(env);
+    }
+}   // eleveldb_status
+
 
+/**
+ * Counters of one priority class for eleveldb_pool_status
+ */
+static ERL_NIF_TERM
+pool_class_status(
+    ErlNifEnv* env,
+    eleveldb::TaskPool & pool,
+    eleveldb::TaskPriority priority,
+    ERL_NIF_TERM name)
+{
+    const eleveldb::TaskClassStats & stats(pool.ClassStats(priority));
+    ERL_NIF_TERM counters[11];
 
-        // reset for next race
-        itr_ptr->m_Iter->m_HandoffAtomic=0;
+    counters[0]=enif_make_tuple2(env, eleveldb::ATOM_THREADS, enif_make_ulong(env, pool.ClassThreads(priority)));
+    counters[1]=enif_make_tuple2(env, eleveldb::ATOM_QUEUE_DEPTH, enif_make_ulong(env, pool.ClassQueueDepth(priority)));
+    counters[2]=enif_make_tuple2(env, eleveldb::ATOM_SUBMITTED, enif_make_uint64(env, stats.m_Submitted));
+    counters[3]=enif_make_tuple2(env, eleveldb::ATOM_QUEUED, enif_make_uint64(env, stats.m_Queued));
+    counters[4]=enif_make_tuple2(env, eleveldb::ATOM_BORROWED, enif_make_uint64(env, stats.m_Borrowed));
+    counters[5]=enif_make_tuple2(env, eleveldb::ATOM_STARTED, enif_make_uint64(env, stats.m_Started));
+    counters[6]=enif_make_tuple2(env, eleveldb::ATOM_WAIT_US, enif_make_uint64(env, stats.m_WaitMicros));
+    counters[7]=enif_make_tuple2(env, eleveldb::ATOM_WAIT_MAX_US, enif_make_uint64(env, stats.m_WaitMax));
+    counters[8]=enif_make_tuple2(env, eleveldb::ATOM_RUN_US, enif_make_uint64(env, stats.m_RunMicros));
+    counters[9]=enif_make_tuple2(env, eleveldb::ATOM_EXPIRED, enif_make_uint64(env, stats.m_Expired));
+    counters[10]=enif_make_tuple2(env, eleveldb::ATOM_CANCELLED, enif_make_uint64(env, stats.m_Cancelled));
 
-        // old MoveItem could still be active on its thread, cannot
-        //  reuse ... but the current Iterator is good
-        itr_ptr->ReleaseReuseMove();
+    return(enif_make_tuple2(env, name, enif_make_list_from_array(env, counters, 11)));
 
-        if (eleveldb::MoveTask::PREFETCH_STOP != action
-            && itr_ptr->m_Iter->Valid())
-        {
-            submit_new_request=true;
-        }   // if
-        else
-        {
-            submit_new_request=false;
-            itr_ptr->m_Iter->m_HandoffAtomic=0;
-            itr_ptr->m_Iter->m_PrefetchStarted=false;
-        }   // else
+}   // pool_class_status
 
 
-    }   // else
+/**
+ * Worker pool layout and counters:
+ *  [{threads, Total}, {resizes, N}, {retiring, N},
+ *   {shards, [[{cpus, N}, {queue_depth, N}, {submitted, N}, ...], ...]},
+ *   {classes, [{interactive, [{threads, N}, {wait_us, N}, ...]}, {bulk, ...}, {admin, ...}]}]
+ */
+ERL_NIF_TERM
+eleveldb_pool_status(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+    eleveldb::TaskPool & pool(priv.thread_pool);
+    ERL_NIF_TERM shards, shard, classes, result;
+    size_t loop;
 
+    shards=enif_make_list(env, 0);
 
-    // only build request if actually need to submit it
-    if (submit_new_request)
+    // build from last shard so list is in shard order
+    for (loop=pool.ShardCount(); 0<loop; --loop)
     {
-        eleveldb::MoveTask * move_item;
+        const eleveldb::TaskShardStats & stats(pool.Stats(loop-1));
 
-        move_item = new eleveldb::MoveTask(env, caller_ref,
-                                           itr_ptr->m_Iter.get(), action);
+        shard=enif_make_list6(env,
+            enif_make_tuple2(env, eleveldb::ATOM_CPUS, enif_make_ulong(env, pool.ShardCpuCount(loop-1))),
+            enif_make_tuple2(env, eleveldb::ATOM_QUEUE_DEPTH, enif_make_ulong(env, pool.QueueDepth(loop-1))),
+            enif_make_tuple2(env, eleveldb::ATOM_SUBMITTED, enif_make_uint64(env, stats.m_Submitted)),
+            enif_make_tuple2(env, eleveldb::ATOM_DIRECT, enif_make_uint64(env, stats.m_Direct)),
+            enif_make_tuple2(env, eleveldb::ATOM_STOLEN, enif_make_uint64(env, stats.m_Stolen)),
+            enif_make_tuple2(env, eleveldb::ATOM_QUEUED, enif_make_uint64(env, stats.m_Queued)));
 
-        // prevent deletes during worker loop
-        move_item->RefInc();
-        itr_ptr->reuse_move=move_item;
+        shards=enif_make_list_cell(env, shard, shards);
+    }   // for
 
-        move_item->action=action;
+    classes=enif_make_list3(env,
+        pool_class_status(env, pool, eleveldb::ePriorityInteractive, eleveldb::ATOM_INTERACTIVE),
+        pool_class_status(env, pool, eleveldb::ePriorityBulk, eleveldb::ATOM_BULK),
+        pool_class_status(env, pool, eleveldb::ePriorityAdmin, eleveldb::ATOM_ADMIN));
 
-        if (eleveldb::MoveTask::SEEK == action)
-        {
-            ErlNifBinary key;
+    result=enif_make_list5(env,
+        enif_make_tuple2(env, eleveldb::ATOM_THREADS, enif_make_ulong(env, pool.ThreadCount())),
+        enif_make_tuple2(env, eleveldb::ATOM_RESIZES, enif_make_uint64(env, pool.ResizeCount())),
+        enif_make_tuple2(env, eleveldb::ATOM_RETIRING, enif_make_ulong(env, pool.RetiringCount())),
+        enif_make_tuple2(env, eleveldb::ATOM_SHARDS, shards),
+        enif_make_tuple2(env, eleveldb::ATOM_CLASSES, classes));
 
-            if(!enif_inspect_binary(env, action_or_target, &key))
-            {
-                itr_ptr->ReleaseReuseMove();
-                itr_ptr->reuse_move=NULL;
-                return enif_make_tuple2(env, ATOM_EINVAL, caller_ref);
-            }   // if
+    return(result);
 
-            move_item->seek_target.assign((const char *)key.data, key.size);
-        }   // else
+}   // eleveldb_pool_status
 
-        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
 
-        if(false == priv.thread_pool.Submit(move_item))
-        {
-            itr_ptr->ReleaseReuseMove();
-            itr_ptr->reuse_move=NULL;
-            return enif_make_tuple2(env, ATOM_ERROR, caller_ref);
-        }   // if
-    }   // if
+/**
+ * Node memory budget and each open database's measured use and
+ *  share of it, as of the last rebalance
+ */
+ERL_NIF_TERM
+eleveldb_memory_status(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+    eleveldb::MemoryGovernor & governor(priv.m_Governor);
+    std::vector<eleveldb::DbObject *> dbs;
+    std::vector<eleveldb::DbObject *>::reverse_iterator it;
+    ERL_NIF_TERM databases, db_term, name_bin, counters[7], status[7];
 
-    return ret_term;
+    governor.GetDbs(dbs);
+    databases=enif_make_list(env, 0);
 
-}   // async_iter_move
+    for (it=dbs.rbegin(); dbs.rend()!=it; ++it)
+    {
+        const eleveldb::DbMemory & mem((*it)->m_Memory);
+
+        name_bin=slice_to_binary(env, (*it)->m_DbName);
+        counters[0]=enif_make_tuple2(env, eleveldb::ATOM_NAME, name_bin);
+        counters[1]=enif_make_tuple2(env, eleveldb::ATOM_BUDGET, enif_make_uint64(env, mem.m_Budget));
+        counters[2]=enif_make_tuple2(env, eleveldb::ATOM_USED, enif_make_uint64(env, mem.Used()));
+        counters[3]=enif_make_tuple2(env, eleveldb::ATOM_BLOCK_CACHE, enif_make_uint64(env, mem.m_BlockCache));
+        counters[4]=enif_make_tuple2(env, eleveldb::ATOM_FILE_CACHE, enif_make_uint64(env, mem.m_FileCache));
+        counters[5]=enif_make_tuple2(env, eleveldb::ATOM_MEMTABLE, enif_make_uint64(env, mem.m_MemTable));
+        counters[6]=enif_make_tuple2(env, eleveldb::ATOM_TASKS, enif_make_uint64(env, (*it)->m_TaskCount));
+        db_term=enif_make_list_from_array(env, counters, 7);
 
+        databases=enif_make_list_cell(env, db_term, databases);
+        (*it)->RefDec();
+    }   // for
 
+    status[0]=enif_make_tuple2(env, eleveldb::ATOM_BUDGET, enif_make_uint64(env, governor.Budget()));
+    status[1]=enif_make_tuple2(env, eleveldb::ATOM_CGROUP_LIMIT, enif_make_uint64(env, governor.CgroupLimit()));
+    status[2]=enif_make_tuple2(env, eleveldb::ATOM_USED, enif_make_uint64(env, governor.Used()));
+    status[3]=enif_make_tuple2(env, eleveldb::ATOM_REBALANCES, enif_make_uint64(env, governor.RebalanceCount()));
+    status[4]=enif_make_tuple2(env, eleveldb::ATOM_SHED_PERCENT, enif_make_uint(env, governor.ShedPercent()));
+    status[5]=enif_make_tuple2(env, eleveldb::ATOM_RECLAIMED, enif_make_uint64(env, governor.Reclaimed()));
+    status[6]=enif_make_tuple2(env, eleveldb::ATOM_DATABASES, databases);
+
+    return(enif_make_list_from_array(env, status, 7));
+
+}   // eleveldb_memory_status
+
+
+/**
+ * Replace the shard threads (eleveldb_threads) with a new count.
+ *  Tasks in flight finish on the old threads, which exit once
+ *  their queues are empty.  Returns ok, or badarg for N < 1.
+ */
 ERL_NIF_TERM
-async_close(
+eleveldb_set_threads(
     ErlNifEnv* env,
     int argc,
     const ERL_NIF_TERM argv[])
 {
-    const ERL_NIF_TERM& caller_ref  = argv[0];
-    const ERL_NIF_TERM& dbh_ref     = argv[1];
-    bool term_ok=false;
-
-    ReferencePtr<DbObject> db_ptr;
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+    unsigned long threads;
 
-    db_ptr.assign(DbObject::RetrieveDbObject(env, dbh_ref, &term_ok));
+    if (!enif_get_ulong(env, argv[0], &threads) || 0==threads)
+        return enif_make_badarg(env);
 
-    if(NULL==db_ptr.get() || 0!=db_ptr->GetCloseRequested())
-    {
-       return enif_make_badarg(env);
-    }
+    if (!priv.thread_pool.SetThreads(threads))
+        return enif_make_badarg(env);
 
-    // verify that Erlang has not called DbObjectResourceCleanup
-    //  already (that would be bad)
-    if (NULL!=db_ptr->m_Db
-//        && compare_and_swap(db_ptr->m_ErlangThisPtr, db_ptr.get(), (DbObject *)NULL))
-        && db_ptr->ClaimCloseFromCThread())
-    {
-        eleveldb::WorkTask *work_item = new eleveldb::CloseTask(env, caller_ref,
-                                                                db_ptr.get());
+    return(eleveldb::ATOM_OK);
 
-        // Now-boilerplate setup (we'll consolidate this pattern soon, I hope):
-        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+}   // eleveldb_set_threads
 
-        if(false == priv.thread_pool.Submit(work_item))
-        {
-            delete work_item;
-            return send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
-        }   // if
-    }   // if
-    else if (!term_ok)
-    {
-        return send_reply(env, caller_ref, error_einval(env));
-    }   // else
 
-    return ATOM_OK;
+/**
+ * Percentiles of one LatencyHistogram, in microseconds
+ */
+static ERL_NIF_TERM
+latency_summary(
+    ErlNifEnv* env,
+    const eleveldb::LatencyHistogram & Histogram)
+{
+    return(enif_make_list5(env,
+        enif_make_tuple2(env, eleveldb::ATOM_COUNT, enif_make_uint64(env, Histogram.Count())),
+        enif_make_tuple2(env, eleveldb::ATOM_P50, enif_make_uint64(env, Histogram.Percentile(0.50))),
+        enif_make_tuple2(env, eleveldb::ATOM_P99, enif_make_uint64(env, Histogram.Percentile(0.99))),
+        enif_make_tuple2(env, eleveldb::ATOM_P999, enif_make_uint64(env, Histogram.Percentile(0.999))),
+        enif_make_tuple2(env, eleveldb::ATOM_MAX, enif_make_uint64(env, Histogram.Max()))));
 
-}  // async_close
+}   // latency_summary
 
 
+/**
+ * Queue wait and service time percentiles per task type:
+ *  [{get, [{wait, [{count, N}, {p50, Us}, ...]}, {service, [...]}]}, {write, ...}, ...]
+ *  eleveldb:task_latency/0 turns this into nested maps.
+ */
 ERL_NIF_TERM
-async_iterator_close(
+eleveldb_task_latency(
     ErlNifEnv* env,
     int argc,
     const ERL_NIF_TERM argv[])
 {
-    const ERL_NIF_TERM& caller_ref  = argv[0];
-    const ERL_NIF_TERM& itr_ref     = argv[1];
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+    ERL_NIF_TERM names[eleveldb::eTaskTypeCount], types;
+    int loop;
 
-    ReferencePtr<ItrObject> itr_ptr;
+    names[eleveldb::eTaskGet]=eleveldb::ATOM_GET;
+    names[eleveldb::eTaskWrite]=eleveldb::ATOM_WRITE;
+    names[eleveldb::eTaskMove]=eleveldb::ATOM_MOVE;
+    names[eleveldb::eTaskOpen]=eleveldb::ATOM_OPEN;
+    names[eleveldb::eTaskClose]=eleveldb::ATOM_CLOSE;
+    names[eleveldb::eTaskOther]=eleveldb::ATOM_OTHER;
 
-    itr_ptr.assign(ItrObject::RetrieveItrObject(env, itr_ref));
+    types=enif_make_list(env, 0);
 
-    if(NULL==itr_ptr.get() || 0!=itr_ptr->GetCloseRequested())
+    for (loop=eleveldb::eTaskTypeCount-1; 0<=loop; --loop)
     {
-       leveldb::gPerfCounters->Inc(leveldb::ePerfDebug4);
-       return enif_make_badarg(env);
-    }
+        const eleveldb::TaskLatency & latency(priv.thread_pool.Latency((eleveldb::TaskType)loop));
+        ERL_NIF_TERM times;
 
-    // verify that Erlang has not called ItrObjectResourceCleanup AND
-    //  that a database close has not already started death proceedings
-    if (itr_ptr->ClaimCloseFromCThread())
-    {
-        eleveldb::WorkTask *work_item = new eleveldb::ItrCloseTask(env, caller_ref,
-                                                                   itr_ptr.get());
+        times=enif_make_list2(env,
+            enif_make_tuple2(env, eleveldb::ATOM_WAIT, latency_summary(env, latency.m_Wait)),
+            enif_make_tuple2(env, eleveldb::ATOM_SERVICE, latency_summary(env, latency.m_Service)));
 
-        // Now-boilerplate setup (we'll consolidate this pattern soon, I hope):
-        eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+        types=enif_make_list_cell(env, enif_make_tuple2(env, names[loop], times), types);
+    }   // for
 
-        if(false == priv.thread_pool.Submit(work_item))
-        {
-            delete work_item;
-            return send_reply(env, caller_ref, enif_make_tuple2(env, ATOM_ERROR, caller_ref));
-        }   // if
-    }   // if
+    return(types);
 
-    // this close/cleanup call is way late ... bad programmer!
-    else
-    {
-        return send_reply(env, caller_ref, error_einval(env));
-    }   // else
+}   // eleveldb_task_latency
 
-    return ATOM_OK;
 
-}   // async_iterator_close
+/**
+ * {Name, Count} for each of the database's DbCounters into Terms
+ */
+static void
+db_counter_terms(
+    ErlNifEnv* env,
+    eleveldb::DbObject * DbPtr,
+    ERL_NIF_TERM * Terms)
+{
+    int loop;
+
+    for (loop=0; loop<eleveldb::eDbCounterCount; ++loop)
+        Terms[loop]=enif_make_tuple2(env, gDbCounterAtoms[loop],
+                                     enif_make_uint64(env, DbPtr->m_Counters.Value((eleveldb::DbCounter)loop)));
 
+    return;
 
+}   // db_counter_terms
+
+
+/**
+ * Operation and byte counters of one database since it was opened,
+ *  see DbCounters.  Lock free, so cheap enough to poll every vnode.
+ */
 ERL_NIF_TERM
-async_destroy(
+eleveldb_db_stats(
     ErlNifEnv* env,
     int argc,
     const ERL_NIF_TERM argv[])
 {
-    char db_name[4096];
+    eleveldb::ReferencePtr<eleveldb::DbObject> db_ptr;
+    ERL_NIF_TERM counters[eleveldb::eDbCounterCount];
 
-    if(!enif_get_string(env, argv[1], db_name, sizeof(db_name), ERL_NIF_LATIN1) ||
-       !enif_is_list(env, argv[2]))
-    {
+    db_ptr.assign(eleveldb::DbObject::RetrieveDbObject(env, argv[0]));
+
+    if (NULL==db_ptr.get())
         return enif_make_badarg(env);
-    }   // if
 
-    ERL_NIF_TERM caller_ref = argv[0];
+    db_counter_terms(env, db_ptr.get(), counters);
 
-    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+    return(enif_make_list_from_array(env, counters, eleveldb::eDbCounterCount));
 
-    leveldb::Options *opts = new leveldb::Options;
-    fold(env, argv[2], parse_open_option, *opts);
+}   // eleveldb_db_stats
 
-    eleveldb::WorkTask *work_item = new eleveldb::DestroyTask(env, caller_ref,
-                                                              db_name, opts);
 
-    if(false == priv.thread_pool.Submit(work_item))
+/**
+ * One entry per open iterator of the database (merge iterator
+ *  sources included) to find leaked iterators:  age and idle
+ *  seconds, MoveTask count, the sequence its snapshot pins (none
+ *  for {snapshot, none} or a purged iterator_refresh iterator)
+ *  and the pid that created it.
+ */
+ERL_NIF_TERM
+eleveldb_iterators(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    eleveldb::ReferencePtr<eleveldb::DbObject> db_ptr;
+    std::list<eleveldb::ItrObject *>::iterator it;
+    ERL_NIF_TERM iterators, fields[5];
+    time_t now;
+
+    db_ptr.assign(eleveldb::DbObject::RetrieveDbObject(env, argv[0]));
+
+    if (NULL==db_ptr.get())
+        return enif_make_badarg(env);
+
+    now=time(NULL);
+    iterators=enif_make_list(env, 0);
+
+    // ItrObject::Shutdown() releases m_Iter under this lock
+    leveldb::MutexLock lock(&db_ptr->m_ItrMutex);
+
+    for (it=db_ptr->m_ItrList.begin(); db_ptr->m_ItrList.end()!=it; ++it)
     {
-        delete work_item;
-        return send_reply(env, caller_ref,
-                          enif_make_tuple2(env, eleveldb::ATOM_ERROR, caller_ref));
-    }
+        eleveldb::LevelIteratorWrapper * wrap((*it)->m_Iter.get());
+        time_t created, last_move;
+        uint64_t snapshot_seq;
 
-    return eleveldb::ATOM_OK;
+        // closing
+        if (NULL==wrap)
+            continue;
 
-}   // async_destroy
+        created=wrap->m_IteratorCreated;
+        last_move=wrap->m_LastMove;
+        snapshot_seq=wrap->m_SnapshotSeq;
 
-} // namespace eleveldb
+        fields[0]=enif_make_tuple2(env, eleveldb::ATOM_AGE,
+                                   enif_make_uint64(env, created<now ? now-created : 0));
+        fields[1]=enif_make_tuple2(env, eleveldb::ATOM_IDLE,
+                                   enif_make_uint64(env, last_move<now ? now-last_move : 0));
+        fields[2]=enif_make_tuple2(env, eleveldb::ATOM_MOVES, enif_make_uint64(env, wrap->m_MoveCount));
+        fields[3]=enif_make_tuple2(env, eleveldb::ATOM_SNAPSHOT,
+                                   0!=snapshot_seq ? enif_make_uint64(env, snapshot_seq-1)
+                                                   : eleveldb::ATOM_NONE);
+        fields[4]=enif_make_tuple2(env, eleveldb::ATOM_OWNER,
+                                   0!=(*it)->owner_pid ? enif_make_copy(env, (*it)->owner_pid)
+                                                       : eleveldb::ATOM_NONE);
+
+        iterators=enif_make_list_cell(env, enif_make_list_from_array(env, fields, 5), iterators);
+    }   // for
+
+    return(iterators);
+
+}   // eleveldb_iterators
 
 
 /**
- * HEY YOU ... please make async
+ * Snapshot for metrics exporters polling every second:  all leveldb
+ *  perf counters and eleveldb's counters of each open database.
+ *  Nothing here calls into leveldb or takes a database lock.
+ *  Returns {PerfCounters, Databases}, eleveldb:metrics/0 adds the
+ *  pool and memory status.
  */
 ERL_NIF_TERM
-eleveldb_status(
+eleveldb_metrics(
     ErlNifEnv* env,
     int argc,
     const ERL_NIF_TERM argv[])
 {
-    ErlNifBinary name_bin;
-    eleveldb::ReferencePtr<eleveldb::DbObject> db_ptr;
+    eleveldb_priv_data& priv = *static_cast<eleveldb_priv_data *>(enif_priv_data(env));
+    ERL_NIF_TERM perf[leveldb::ePerfCountEnumSize], counters[10+eleveldb::eDbCounterCount], databases;
+    std::vector<eleveldb::DbObject *> dbs;
+    std::vector<eleveldb::DbObject *>::reverse_iterator it;
+    int loop;
 
-    db_ptr.assign(eleveldb::DbObject::RetrieveDbObject(env, argv[0]));
+    for (loop=0; loop<leveldb::ePerfCountEnumSize; ++loop)
+        perf[loop]=enif_make_tuple2(env, gPerfCounterAtoms[loop],
+                                    enif_make_uint64(env, leveldb::gPerfCounters->Value(loop)));
 
-    if(NULL!=db_ptr.get()
-       && enif_inspect_binary(env, argv[1], &name_bin))
+    priv.m_Governor.GetDbs(dbs);
+    databases=enif_make_list(env, 0);
+
+    for (it=dbs.rbegin(); dbs.rend()!=it; ++it)
     {
-        if (db_ptr->m_Db == NULL)
+        eleveldb::DbObject * db_ptr(*it);
+        const eleveldb::DbMemory & mem(db_ptr->m_Memory);
+        size_t iterators, pooled;
+
         {
-            return error_einval(env);
+            leveldb::MutexLock lock(&db_ptr->m_ItrMutex);
+            iterators=db_ptr->m_ItrList.size();
+            pooled=db_ptr->m_WrapperPool.size();
         }
 
-        leveldb::Slice name((const char*)name_bin.data, name_bin.size);
-        std::string value;
-        if (db_ptr->m_Db->GetProperty(name, &value))
-        {
-            ERL_NIF_TERM result;
-            unsigned char* result_buf = enif_make_new_binary(env, value.size(), &result);
-            memcpy(result_buf, value.c_str(), value.size());
+        counters[0]=enif_make_tuple2(env, eleveldb::ATOM_NAME, slice_to_binary(env, db_ptr->m_DbName));
+        counters[1]=enif_make_tuple2(env, eleveldb::ATOM_TASKS, enif_make_uint64(env, db_ptr->m_TaskCount));
+        counters[2]=enif_make_tuple2(env, eleveldb::ATOM_ITERATORS, enif_make_ulong(env, iterators));
+        counters[3]=enif_make_tuple2(env, eleveldb::ATOM_POOLED, enif_make_ulong(env, pooled));
+        counters[4]=enif_make_tuple2(env, eleveldb::ATOM_SNAPSHOTS, enif_make_uint64(env, db_ptr->m_ItrSnapshots));
+        counters[5]=enif_make_tuple2(env, eleveldb::ATOM_PINNED_BYTES, enif_make_uint64(env, db_ptr->m_ItrPinnedBytes));
+        counters[6]=enif_make_tuple2(env, eleveldb::ATOM_BLOCK_CACHE, enif_make_uint64(env, mem.m_BlockCache));
+        counters[7]=enif_make_tuple2(env, eleveldb::ATOM_FILE_CACHE, enif_make_uint64(env, mem.m_FileCache));
+        counters[8]=enif_make_tuple2(env, eleveldb::ATOM_MEMTABLE, enif_make_uint64(env, mem.m_MemTable));
+        counters[9]=enif_make_tuple2(env, eleveldb::ATOM_BUDGET, enif_make_uint64(env, mem.m_Budget));
 
-            return enif_make_tuple2(env, eleveldb::ATOM_OK, result);
-        }
-        else
-        {
-            return eleveldb::ATOM_ERROR;
-        }
-    }
-    else
-    {
+        db_counter_terms(env, db_ptr, counters+10);
+
+        databases=enif_make_list_cell(env,
+                                      enif_make_list_from_array(env, counters, 10+eleveldb::eDbCounterCount),
+                                      databases);
+        db_ptr->RefDec();
+    }   // for
+
+    return(enif_make_tuple2(env,
+                            enif_make_list_from_array(env, perf, leveldb::ePerfCountEnumSize),
+                            databases));
+
+}   // eleveldb_metrics
+
+
+/**
+ * New token for the {cancel, Token} option
+ */
+ERL_NIF_TERM
+eleveldb_cancel_token(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    void * cancel_ptr_ptr;
+    ERL_NIF_TERM result;
+
+    cancel_ptr_ptr=eleveldb::CancelObject::CreateCancelObject();
+    result=enif_make_resource(env, cancel_ptr_ptr);
+
+    // clear the automatic reference from enif_alloc_resource in CreateCancelObject
+    enif_release_resource(cancel_ptr_ptr);
+
+    return(result);
+
+}   // eleveldb_cancel_token
+
+
+/**
+ * Drop every queued task holding Token.  Tasks already in
+ *  leveldb finish normally.
+ */
+ERL_NIF_TERM
+eleveldb_cancel(
+    ErlNifEnv* env,
+    int argc,
+    const ERL_NIF_TERM argv[])
+{
+    eleveldb::CancelObject * cancel_ptr;
+
+    cancel_ptr=eleveldb::CancelObject::RetrieveCancelObject(env, argv[0]);
+    if (NULL==cancel_ptr)
         return enif_make_badarg(env);
-    }
-}   // eleveldb_status
+
+    cancel_ptr->Cancel();
+
+    return(eleveldb::ATOM_OK);
+
+}   // eleveldb_cancel
 
 
 /**
- * HEY YOU ... please make async
+ * Synchronous repair, blocks the calling scheduler for the whole
+ *  repair.  eleveldb:repair/2 uses async_repair instead.
  */
 ERL_NIF_TERM
 eleveldb_repair(
@@ -1275,6 +2845,10 @@ static void on_unload(ErlNifEnv *env, void *priv_data)
     eleveldb_priv_data *p = static_cast<eleveldb_priv_data *>(priv_data);
     delete p;
 
+    // pool threads are gone, nothing can return items any more
+    eleveldb::TaskMemory::Drain();
+    eleveldb::EnvPool::Drain();
+
     leveldb::Env::Shutdown();
 }
 
@@ -1294,6 +2868,8 @@ try
     // inform erlang of our two resource types
     eleveldb::DbObject::CreateDbObjectType(env);
     eleveldb::ItrObject::CreateItrObjectType(env);
+    eleveldb::MergeItrObject::CreateMergeItrObjectType(env);
+    eleveldb::CancelObject::CreateCancelObjectType(env);
 
 // must initialize atoms before processing options
 #define ATOM(Id, Value) { Id = enif_make_atom(env, Value); }
@@ -1330,7 +2906,19 @@ try
     ATOM(eleveldb::ATOM_PREV, "prev");
     ATOM(eleveldb::ATOM_PREFETCH, "prefetch");
     ATOM(eleveldb::ATOM_PREFETCH_STOP, "prefetch_stop");
+    ATOM(eleveldb::ATOM_PREFETCH_DEPTH, "prefetch_depth");
+    ATOM(eleveldb::ATOM_ITERATOR_REFRESH_INTERVAL, "iterator_refresh_interval");
+    ATOM(eleveldb::ATOM_ITERATOR_REFRESH_MOVES, "iterator_refresh_moves");
+    ATOM(eleveldb::ATOM_ITERATOR_REFRESH_BYTES, "iterator_refresh_bytes");
+    ATOM(eleveldb::ATOM_ITERATOR_POOL_SIZE, "iterator_pool_size");
+    ATOM(eleveldb::ATOM_SCAN_MODE, "scan_mode");
+    ATOM(eleveldb::ATOM_SEQUENTIAL, "sequential");
     ATOM(eleveldb::ATOM_INVALID_ITERATOR, "invalid_iterator");
+    ATOM(eleveldb::ATOM_PACKED, "packed");
+    ATOM(eleveldb::ATOM_CONTINUATION, "continuation");
+    ATOM(eleveldb::ATOM_RESUME, "resume");
+    ATOM(eleveldb::ATOM_SNAPSHOT, "snapshot");
+    ATOM(eleveldb::ATOM_NONE, "none");
     ATOM(eleveldb::ATOM_PARANOID_CHECKS, "paranoid_checks");
     ATOM(eleveldb::ATOM_VERIFY_COMPACTIONS, "verify_compactions");
     ATOM(eleveldb::ATOM_ERROR_DB_DESTROY, "error_db_destroy");
@@ -1349,6 +2937,79 @@ try
     ATOM(eleveldb::ATOM_IS_INTERNAL_DB, "is_internal_db");
     ATOM(eleveldb::ATOM_LIMITED_DEVELOPER_MEM, "limited_developer_mem");
     ATOM(eleveldb::ATOM_ELEVELDB_THREADS, "eleveldb_threads");
+    ATOM(eleveldb::ATOM_ELEVELDB_POOL_SHARDS, "eleveldb_pool_shards");
+    ATOM(eleveldb::ATOM_THREADS, "threads");
+    ATOM(eleveldb::ATOM_SHARDS, "shards");
+    ATOM(eleveldb::ATOM_QUEUE_DEPTH, "queue_depth");
+    ATOM(eleveldb::ATOM_SUBMITTED, "submitted");
+    ATOM(eleveldb::ATOM_DIRECT, "direct");
+    ATOM(eleveldb::ATOM_STOLEN, "stolen");
+    ATOM(eleveldb::ATOM_QUEUED, "queued");
+    ATOM(eleveldb::ATOM_ELEVELDB_BULK_THREADS, "eleveldb_bulk_threads");
+    ATOM(eleveldb::ATOM_ELEVELDB_ADMIN_THREADS, "eleveldb_admin_threads");
+    ATOM(eleveldb::ATOM_ELEVELDB_CPU_SET, "eleveldb_cpu_set");
+    ATOM(eleveldb::ATOM_ELEVELDB_NUMA, "eleveldb_numa");
+    ATOM(eleveldb::ATOM_CPUS, "cpus");
+    ATOM(eleveldb::ATOM_CLASSES, "classes");
+    ATOM(eleveldb::ATOM_RESIZES, "resizes");
+    ATOM(eleveldb::ATOM_RETIRING, "retiring");
+    ATOM(eleveldb::ATOM_GET, "get");
+    ATOM(eleveldb::ATOM_WRITE, "write");
+    ATOM(eleveldb::ATOM_MOVE, "move");
+    ATOM(eleveldb::ATOM_OPEN, "open");
+    ATOM(eleveldb::ATOM_CLOSE, "close");
+    ATOM(eleveldb::ATOM_OTHER, "other");
+    ATOM(eleveldb::ATOM_WAIT, "wait");
+    ATOM(eleveldb::ATOM_SERVICE, "service");
+    ATOM(eleveldb::ATOM_COUNT, "count");
+    ATOM(eleveldb::ATOM_P50, "p50");
+    ATOM(eleveldb::ATOM_P99, "p99");
+    ATOM(eleveldb::ATOM_P999, "p999");
+    ATOM(eleveldb::ATOM_MAX, "max");
+    ATOM(eleveldb::ATOM_DEADLINE, "deadline");
+    ATOM(eleveldb::ATOM_CANCEL, "cancel");
+    ATOM(eleveldb::ATOM_TIMEOUT, "timeout");
+    ATOM(eleveldb::ATOM_CANCELLED, "cancelled");
+    ATOM(eleveldb::ATOM_EXPIRED, "expired");
+    ATOM(eleveldb::ATOM_INTERACTIVE, "interactive");
+    ATOM(eleveldb::ATOM_BULK, "bulk");
+    ATOM(eleveldb::ATOM_ADMIN, "admin");
+    ATOM(eleveldb::ATOM_BORROWED, "borrowed");
+    ATOM(eleveldb::ATOM_STARTED, "started");
+    ATOM(eleveldb::ATOM_WAIT_US, "wait_us");
+    ATOM(eleveldb::ATOM_WAIT_MAX_US, "wait_max_us");
+    ATOM(eleveldb::ATOM_RUN_US, "run_us");
+    ATOM(eleveldb::ATOM_DIRTY_IO, "dirty_io");
+    ATOM(eleveldb::ATOM_REPAIR_PROGRESS, "repair_progress");
+    ATOM(eleveldb::ATOM_LOGS, "logs");
+    ATOM(eleveldb::ATOM_TABLES, "tables");
+    ATOM(eleveldb::ATOM_ENTRIES, "entries");
+    ATOM(eleveldb::ATOM_BYTES, "bytes");
+    ATOM(eleveldb::ATOM_ELEVELDB_MEMORY_INTERVAL, "eleveldb_memory_interval");
+    ATOM(eleveldb::ATOM_BUDGET, "budget");
+    ATOM(eleveldb::ATOM_USED, "used");
+    ATOM(eleveldb::ATOM_REBALANCES, "rebalances");
+    ATOM(eleveldb::ATOM_DATABASES, "databases");
+    ATOM(eleveldb::ATOM_NAME, "name");
+    ATOM(eleveldb::ATOM_BLOCK_CACHE, "block_cache");
+    ATOM(eleveldb::ATOM_FILE_CACHE, "file_cache");
+    ATOM(eleveldb::ATOM_MEMTABLE, "memtable");
+    ATOM(eleveldb::ATOM_TASKS, "tasks");
+    ATOM(eleveldb::ATOM_CGROUP_LIMIT, "cgroup_limit");
+    ATOM(eleveldb::ATOM_ELEVELDB_MEMORY_HIGH_WATERMARK, "eleveldb_memory_high_watermark");
+    ATOM(eleveldb::ATOM_SHED_PERCENT, "shed_percent");
+    ATOM(eleveldb::ATOM_RECLAIMED, "reclaimed");
+    ATOM(eleveldb::ATOM_PERF, "perf");
+    ATOM(eleveldb::ATOM_ITERATORS, "iterators");
+    ATOM(eleveldb::ATOM_SNAPSHOTS, "snapshots");
+    ATOM(eleveldb::ATOM_PINNED_BYTES, "pinned_bytes");
+    ATOM(eleveldb::ATOM_POOLED, "pooled");
+    ATOM(eleveldb::ATOM_BUSY, "busy");
+    ATOM(eleveldb::ATOM_ITERATOR_IDLE_CLOSE, "iterator_idle_close");
+    ATOM(eleveldb::ATOM_AGE, "age");
+    ATOM(eleveldb::ATOM_IDLE, "idle");
+    ATOM(eleveldb::ATOM_MOVES, "moves");
+    ATOM(eleveldb::ATOM_OWNER, "owner");
     ATOM(eleveldb::ATOM_FADVISE_WILLNEED, "fadvise_willneed");
     ATOM(eleveldb::ATOM_DELETE_THRESHOLD, "delete_threshold");
     ATOM(eleveldb::ATOM_TIERED_SLOW_LEVEL, "tiered_slow_level");
@@ -1360,6 +3021,14 @@ try
     ATOM(eleveldb::ATOM_WHOLE_FILE_EXPIRY, "whole_file_expiry");
 #undef ATOM
 
+    for (int loop=0; loop<leveldb::ePerfCountEnumSize; ++loop)
+    {
+        const char * name(leveldb::PerformanceCounters::GetNamePtr(loop));
+        gPerfCounterAtoms[loop]=enif_make_atom(env, NULL!=name ? name : "unknown");
+    }   // for
+
+    for (int loop=0; loop<eleveldb::eDbCounterCount; ++loop)
+        gDbCounterAtoms[loop]=enif_make_atom(env, eleveldb::DbCounters::Name((eleveldb::DbCounter)loop));
 
     // read options that apply to global eleveldb environment
     if(enif_is_list(env, load_info))
@@ -1368,6 +3037,14 @@ try
 
         fold(env, load_info, parse_init_option, load_options);
 
+        eleveldb::DbObject::m_WrapperPoolMax=load_options.m_IteratorPoolSize;
+        eleveldb::DbObject::m_ItrIdleClose=load_options.m_IteratorIdleClose;
+
+        // idle iterators are only closed by MemoryGovernor::Rebalance()
+        if (0!=load_options.m_IteratorIdleClose && 0==load_options.m_MemoryInterval)
+            syslog(LOG_WARNING, "eleveldb: iterator_idle_close %u has no effect, eleveldb_memory_interval is 0",
+                   load_options.m_IteratorIdleClose);
+
         /* Spin up the thread pool, set up all private data: */
         eleveldb_priv_data *priv = new eleveldb_priv_data(load_options);
 
@@ -0,0 +1,242 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_FREELIST_H
+    #include "freelist.h"
+#endif
+
+#include <new>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util/mutexlock.h"
+
+
+namespace eleveldb {
+
+/**
+ * FreeList functions
+ */
+
+void *
+FreeList::Pop()
+{
+    size_t home, loop, shard;
+    void * ret_ptr(NULL);
+
+    home=ThreadShard();
+
+    for (loop=0; NULL==ret_ptr && loop<eShards; ++loop)
+    {
+        shard=(home+loop) % eShards;
+
+        // unlocked peek, an empty shard is not worth the mutex
+        if (0!=m_Shards[shard].m_Count)
+        {
+            leveldb::MutexLock lock(&m_Shards[shard].m_Mutex);
+
+            if (!m_Shards[shard].m_Items.empty())
+            {
+                ret_ptr=m_Shards[shard].m_Items.back();
+                m_Shards[shard].m_Items.pop_back();
+                m_Shards[shard].m_Count=m_Shards[shard].m_Items.size();
+            }   // if
+        }   // if
+    }   // for
+
+    return(ret_ptr);
+
+}   // FreeList::Pop
+
+
+bool
+FreeList::Push(
+    void * Item)
+{
+    Shard & shard(m_Shards[ThreadShard()]);
+    leveldb::MutexLock lock(&shard.m_Mutex);
+
+    if (eShardLimit<=shard.m_Items.size())
+        return(false);
+
+    shard.m_Items.push_back(Item);
+    shard.m_Count=shard.m_Items.size();
+
+    return(true);
+
+}   // FreeList::Push
+
+
+void
+FreeList::Drain(
+    std::vector<void *> & Items)
+{
+    size_t loop;
+
+    for (loop=0; loop<eShards; ++loop)
+    {
+        leveldb::MutexLock lock(&m_Shards[loop].m_Mutex);
+
+        Items.insert(Items.end(), m_Shards[loop].m_Items.begin(), m_Shards[loop].m_Items.end());
+        m_Shards[loop].m_Items.clear();
+        m_Shards[loop].m_Count=0;
+    }   // for
+
+}   // FreeList::Drain
+
+
+/**
+ * pthread_t is usually the address of the thread's control block,
+ *  spaced a stack size apart.  Mix all bits before taking the shard.
+ */
+size_t
+FreeList::ThreadShard()
+{
+    uint64_t hash;
+
+    hash=(uint64_t)(uintptr_t)pthread_self();
+    hash^=hash >> 33;
+    hash*=0xff51afd7ed558ccdULL;
+    hash^=hash >> 33;
+
+    return((size_t)(hash % eShards));
+
+}   // FreeList::ThreadShard
+
+
+/**
+ * EnvPool functions
+ */
+
+static FreeList gEnvList;
+
+
+ErlNifEnv *
+EnvPool::Alloc()
+{
+    ErlNifEnv * env;
+
+    env=(ErlNifEnv *)gEnvList.Pop();
+    if (NULL==env)
+        env=enif_alloc_env();
+
+    return(env);
+
+}   // EnvPool::Alloc
+
+
+void
+EnvPool::Free(
+    ErlNifEnv * Env)
+{
+    if (NULL!=Env)
+    {
+        enif_clear_env(Env);
+
+        if (!gEnvList.Push(Env))
+            enif_free_env(Env);
+    }   // if
+
+}   // EnvPool::Free
+
+
+void
+EnvPool::Drain()
+{
+    std::vector<void *> items;
+    std::vector<void *>::iterator it;
+
+    gEnvList.Drain(items);
+    for (it=items.begin(); items.end()!=it; ++it)
+        enif_free_env((ErlNifEnv *)*it);
+
+}   // EnvPool::Drain
+
+
+/**
+ * TaskMemory functions
+ */
+
+static FreeList gTaskLists[TaskMemory::eClassCount];
+
+
+void *
+TaskMemory::Alloc(
+    size_t Size)
+{
+    size_t index;
+    void * ret_ptr(NULL);
+
+    index=(Size+eClassSize-1)/eClassSize;
+
+    if (0!=index && index<=eClassCount)
+    {
+        ret_ptr=gTaskLists[index-1].Pop();
+        if (NULL==ret_ptr)
+            ret_ptr=malloc(index*eClassSize);
+    }   // if
+    else
+    {
+        ret_ptr=malloc(Size);
+    }   // else
+
+    if (NULL==ret_ptr)
+        throw std::bad_alloc();
+
+    return(ret_ptr);
+
+}   // TaskMemory::Alloc
+
+
+void
+TaskMemory::Free(
+    void * Ptr,
+    size_t Size)
+{
+    size_t index;
+
+    index=(Size+eClassSize-1)/eClassSize;
+
+    if (NULL!=Ptr
+        && (0==index || eClassCount<index || !gTaskLists[index-1].Push(Ptr)))
+        free(Ptr);
+
+}   // TaskMemory::Free
+
+
+void
+TaskMemory::Drain()
+{
+    std::vector<void *> items;
+    std::vector<void *>::iterator it;
+    size_t loop;
+
+    for (loop=0; loop<eClassCount; ++loop)
+        gTaskLists[loop].Drain(items);
+
+    for (it=items.begin(); items.end()!=it; ++it)
+        free(*it);
+
+}   // TaskMemory::Drain
+
+} // namespace eleveldb
@@ -0,0 +1,121 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_FREELIST_H
+#define INCL_FREELIST_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "erl_nif.h"
+#include "port/port.h"
+
+namespace eleveldb {
+
+/**
+ * Stack of recycled items, split in shards by thread to keep lock
+ *  contention low.  Request objects are built on Erlang scheduler
+ *  threads and released on worker threads, so a thread that finds
+ *  its own shard empty takes from the others before giving up.
+ */
+class FreeList
+{
+public:
+    enum
+    {
+        eShards=16,
+        eShardLimit=64                   //!< items kept per shard, extras are really freed
+    };
+
+protected:
+    struct Shard
+    {
+        leveldb::port::Mutex m_Mutex;
+        std::vector<void *> m_Items;
+        volatile size_t m_Count;         //!< m_Items.size(), readable without m_Mutex
+
+        Shard() : m_Count(0) {};
+    };
+
+    Shard m_Shards[eShards];
+
+public:
+    FreeList() {};
+
+    // recycled item, or NULL if every shard is empty
+    void * Pop();
+
+    // false if the thread's shard is full, caller must free Item
+    bool Push(void * Item);
+
+    // remove all items into Items
+    void Drain(std::vector<void *> & Items);
+
+protected:
+    static size_t ThreadShard();
+
+private:
+    FreeList(const FreeList &);             // nocopy
+    FreeList & operator=(const FreeList &); // nocopyassign
+};  // class FreeList
+
+
+/**
+ * Process independent environments for task replies.  Released
+ *  environments are cleared with enif_clear_env and reused.
+ */
+class EnvPool
+{
+public:
+    static ErlNifEnv * Alloc();
+
+    static void Free(ErlNifEnv * Env);
+
+    // release all pooled environments, on NIF unload
+    static void Drain();
+};  // class EnvPool
+
+
+/**
+ * Memory for WorkTask objects, see WorkTask::operator new.  Sizes
+ *  are rounded to eClassSize, larger objects use malloc directly.
+ */
+class TaskMemory
+{
+public:
+    enum
+    {
+        eClassSize=128,
+        eClassCount=8
+    };
+
+    static void * Alloc(size_t Size);
+
+    static void Free(void * Ptr, size_t Size);
+
+    static void Drain();
+};  // class TaskMemory
+
+} // namespace eleveldb
+
+
+#endif  // INCL_FREELIST_H
@@ -0,0 +1,545 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_GOVERNOR_H
+    #include "governor.h"
+#endif
+
+#ifndef INCL_REFOBJECTS_H
+    #include "refobjects.h"
+#endif
+
+#ifndef INCL_TASKPOOL_H
+    #include "taskpool.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+
+#include "leveldb/atomics.h"
+#include "leveldb/db.h"
+#include "util/flexcache.h"
+#include "util/mutexlock.h"
+
+
+namespace eleveldb {
+
+#if defined(__linux__)
+/**
+ * Smallest limit in File of Dir/Path and each of its parents.
+ *  "max" (v2) or a value at or above physical memory (v1's
+ *  unlimited) count as no limit.
+ */
+static uint64_t
+cgroup_path_limit(
+    const std::string & Dir,
+    std::string Path,
+    const char * File,
+    uint64_t Physical)
+{
+    uint64_t limit(0), value;
+    size_t slash;
+    FILE * file;
+    char buffer[64];
+
+    while (true)
+    {
+        file=fopen((Dir + Path + "/" + File).c_str(), "r");
+        if (NULL!=file)
+        {
+            if (NULL!=fgets(buffer, sizeof(buffer), file)
+                && 0!=strncmp(buffer, "max", 3))
+            {
+                value=strtoull(buffer, NULL, 10);
+                if (0!=value && value<Physical && (0==limit || value<limit))
+                    limit=value;
+            }   // if
+            fclose(file);
+        }   // if
+
+        if (Path.empty() || "/"==Path)
+            break;
+
+        slash=Path.rfind('/');
+        Path.erase(std::string::npos==slash ? 0 : slash);
+    }   // while
+
+    return(limit);
+
+}   // cgroup_path_limit
+#endif
+
+
+uint64_t
+ReadCgroupMemoryLimit()
+{
+    uint64_t limit(0);
+
+#if defined(__linux__)
+    std::string v2_path, v1_path;
+    uint64_t physical;
+    FILE * file;
+    char line[512], * controllers, * path;
+    bool has_v1(false);
+
+    physical=(uint64_t)sysconf(_SC_PHYS_PAGES) * (uint64_t)sysconf(_SC_PAGE_SIZE);
+
+    // lines are "hierarchy:controllers:path", v2 is "0::path"
+    file=fopen("/proc/self/cgroup", "r");
+    if (NULL!=file)
+    {
+        while (NULL!=fgets(line, sizeof(line), file))
+        {
+            line[strcspn(line, "\n")]='\0';
+            controllers=strchr(line, ':');
+            path=(NULL!=controllers ? strchr(controllers+1, ':') : NULL);
+            if (NULL==path)
+                continue;
+
+            *path++='\0';
+            ++controllers;
+
+            if ('\0'==*controllers)
+                v2_path=path;
+            else if (NULL!=strstr(controllers, "memory"))
+            {
+                v1_path=path;
+                has_v1=true;
+            }   // else if
+        }   // while
+        fclose(file);
+    }   // if
+
+    // inside a cgroup namespace the path is "/" and the files are at the root
+    if (has_v1)
+        limit=cgroup_path_limit("/sys/fs/cgroup/memory", v1_path,
+                                "memory.limit_in_bytes", physical);
+    else
+        limit=cgroup_path_limit("/sys/fs/cgroup", v2_path,
+                                "memory.max", physical);
+#endif
+
+    return(limit);
+
+}   // ReadCgroupMemoryLimit
+
+
+uint64_t
+ReadResidentMemory()
+{
+    uint64_t rss(0);
+
+#if defined(__linux__)
+    unsigned long long size, resident;
+    FILE * file;
+
+    file=fopen("/proc/self/statm", "r");
+    if (NULL!=file)
+    {
+        if (2==fscanf(file, "%llu %llu", &size, &resident))
+            rss=resident * (uint64_t)sysconf(_SC_PAGE_SIZE);
+        fclose(file);
+    }   // if
+#endif
+
+    return(rss);
+
+}   // ReadResidentMemory
+
+
+MemoryGovernor::MemoryGovernor(
+    uint32_t IntervalSeconds,
+    uint64_t TotalMem,
+    int TotalMemPercent,
+    uint32_t HighWatermark)
+    : m_TotalMem(TotalMem), m_TotalMemPercent(TotalMemPercent),
+      m_TotalMemory(0), m_CgroupLimit(ReadCgroupMemoryLimit()),
+      m_Memory(0), m_ShedPercent(0), m_HighWatermark(HighWatermark), m_Reclaimed(0),
+      m_Budget(0), m_Used(0), m_Rebalances(0),
+      m_IntervalMicros(IntervalSeconds * 1000000ULL)
+{
+    Reschedule();
+
+    // a container limit applies before any open gives total_memory
+    leveldb::MutexLock lock(&m_BudgetMutex);
+    UpdateBudget();
+
+}   // MemoryGovernor::MemoryGovernor
+
+
+void
+MemoryGovernor::Register(
+    DbObject * DbPtr)
+{
+    leveldb::MutexLock lock(&m_DbMutex);
+
+    m_Dbs.insert(DbPtr);
+
+}   // MemoryGovernor::Register
+
+
+/**
+ * Called from DbObject::Shutdown(), before the database's own
+ *  reference is released.  Rebalance() only touches databases
+ *  it found registered and holds a reference to.
+ */
+void
+MemoryGovernor::Unregister(
+    DbObject * DbPtr)
+{
+    leveldb::MutexLock lock(&m_DbMutex);
+
+    m_Dbs.erase(DbPtr);
+
+}   // MemoryGovernor::Unregister
+
+
+void
+MemoryGovernor::SetTotalMemory(
+    uint64_t TotalMemory)
+{
+    leveldb::MutexLock lock(&m_BudgetMutex);
+
+    if (TotalMemory!=m_TotalMemory)
+    {
+        m_TotalMemory=TotalMemory;
+        UpdateBudget();
+    }   // if
+
+}   // MemoryGovernor::SetTotalMemory
+
+
+bool
+MemoryGovernor::CheckCgroupLimit()
+{
+    uint64_t limit(ReadCgroupMemoryLimit());
+    leveldb::MutexLock lock(&m_BudgetMutex);
+    bool changed(limit!=m_CgroupLimit);
+
+    if (changed)
+    {
+        m_CgroupLimit=limit;
+        UpdateBudget();
+    }   // if
+
+    return(changed);
+
+}   // MemoryGovernor::CheckCgroupLimit
+
+
+/**
+ * total_leveldb_mem wins, else total_leveldb_mem_percent of the
+ *  memory size, else 80% of memory above 8G or 25% at or below.
+ */
+void
+MemoryGovernor::UpdateBudget()
+{
+    uint64_t memory, budget, old_budget;
+
+    // 1. start with all memory, a smaller container limit wins
+    memory=m_TotalMemory;
+    if (0!=m_CgroupLimit && (0==memory || m_CgroupLimit<memory))
+        memory=m_CgroupLimit;
+    budget=memory;
+
+    // 2. valid percentage given
+    if (0 < m_TotalMemPercent && m_TotalMemPercent<=100)
+        budget=(m_TotalMemPercent * memory)/100;  // integer math for percentage
+
+    // 3. adjust to specific memory size
+    if (0!=m_TotalMem)
+        budget=m_TotalMem;
+
+    // 4. fail safe when no guidance given
+    if (0==m_TotalMem && 0==m_TotalMemPercent)
+    {
+        if (8*1024*1024*1024ULL < memory)
+            budget=(memory * 80)/100;  // integer percent
+        else
+            budget=(memory * 25)/100;  // integer percent
+    }   // if
+
+    // 5. memory pressure
+    if (0!=m_ShedPercent)
+        budget=(budget / 100) * (100 - m_ShedPercent);
+    m_Memory=memory;
+
+    old_budget=m_Budget;
+    if (old_budget!=budget
+        && leveldb::compare_and_swap(&m_Budget, old_budget, budget))
+    {
+        // leveldb recalculates every open database's cache sizes
+        leveldb::gFlexCache.SetTotalMemory(budget);
+    }   // if
+
+}   // MemoryGovernor::UpdateBudget
+
+
+bool
+MemoryGovernor::RebalanceDue()
+{
+    uint64_t next(m_NextRebalance);
+
+    if (0==m_IntervalMicros || 0==next || TaskPool::NowMicros()<next)
+        return(false);
+
+    return(leveldb::compare_and_swap(&m_NextRebalance, next, (uint64_t)0));
+
+}   // MemoryGovernor::RebalanceDue
+
+
+void
+MemoryGovernor::Reschedule()
+{
+    m_NextRebalance=TaskPool::NowMicros() + m_IntervalMicros;
+
+}   // MemoryGovernor::Reschedule
+
+
+void
+MemoryGovernor::GetDbs(
+    std::vector<DbObject *> & Dbs)
+{
+    std::set<DbObject *>::iterator it;
+    leveldb::MutexLock lock(&m_DbMutex);
+
+    // registered databases have not finished Shutdown(), so
+    //  still hold their own reference while RefInc() runs
+    Dbs.reserve(m_Dbs.size());
+    for (it=m_Dbs.begin(); m_Dbs.end()!=it; ++it)
+    {
+        (*it)->RefInc();
+        Dbs.push_back(*it);
+    }   // for
+
+}   // MemoryGovernor::GetDbs
+
+
+/**
+ * Property values are plain numbers.  Unknown properties leave
+ *  the value at 0.
+ */
+static uint64_t
+numeric_property(
+    DbObject * DbPtr,
+    const char * Name)
+{
+    std::string value;
+    uint64_t ret_val(0);
+
+    if (DbPtr->GetProperty(Name, &value))
+        ret_val=strtoull(value.c_str(), NULL, 10);
+
+    return(ret_val);
+
+}   // numeric_property
+
+
+void
+MemoryGovernor::Measure(
+    DbObject * DbPtr)
+{
+    DbMemory & mem(DbPtr->m_Memory);
+
+    if (NULL==DbPtr->m_Db)
+        return;
+
+    mem.m_BlockCache=numeric_property(DbPtr, "leveldb.block-cache");
+    mem.m_FileCache=numeric_property(DbPtr, "leveldb.file-cache");
+    mem.m_MemTable=numeric_property(DbPtr, "leveldb.approximate-memory-usage");
+
+    // assume a full write buffer when leveldb does not report it
+    if (0==mem.m_MemTable && NULL!=DbPtr->m_DbOptions)
+        mem.m_MemTable=DbPtr->m_DbOptions->write_buffer_size;
+
+}   // MemoryGovernor::Measure
+
+
+/**
+ * Runs on a worker thread (ShrinkTask or Rebalance()).  Budget
+ *  change reaches leveldb's caches through gFlexCache.  Memtables
+ *  are not flushed early, leveldb has no call for that short of
+ *  a full CompactRange().  A manual shrink_caches and a watermark
+ *  shed run one at a time so neither overwrites the other's percent.
+ */
+uint64_t
+MemoryGovernor::Shed(
+    uint32_t Percent)
+{
+    leveldb::MutexLock lock(&m_BudgetMutex);
+
+    return(ShedLocked(Percent));
+
+}   // MemoryGovernor::Shed
+
+
+uint64_t
+MemoryGovernor::ShedLocked(
+    uint32_t Percent)
+{
+    std::vector<DbObject *> dbs;
+    std::vector<DbObject *>::iterator it;
+    uint64_t before(0), after(0), reclaimed(0);
+
+    if (100<Percent)
+        Percent=100;
+
+    GetDbs(dbs);
+
+    for (it=dbs.begin(); dbs.end()!=it; ++it)
+    {
+        Measure(*it);
+        before+=(*it)->m_Memory.Used();
+    }   // for
+
+    m_ShedPercent=Percent;
+    UpdateBudget();
+
+    for (it=dbs.begin(); dbs.end()!=it; ++it)
+    {
+        if (0!=Percent)
+            (*it)->DrainWrapperPool();
+
+        Measure(*it);
+        after+=(*it)->m_Memory.Used();
+        (*it)->RefDec();
+    }   // for
+
+    if (after<before)
+    {
+        reclaimed=before - after;
+        leveldb::add_and_fetch(&m_Reclaimed, reclaimed);
+    }   // if
+
+    return(reclaimed);
+
+}   // MemoryGovernor::ShedLocked
+
+
+/**
+ * Above the watermark shed another 25% of the budget, up to 75%.
+ *  Below 90% of the watermark restore half of what is shed.
+ */
+void
+MemoryGovernor::CheckWatermark()
+{
+    uint64_t memory, rss, high;
+    uint32_t shed;
+
+    if (0==m_HighWatermark)
+        return;
+
+    // read and new percent under one lock, a manual Shed() may run
+    leveldb::MutexLock lock(&m_BudgetMutex);
+    memory=m_Memory;
+    shed=m_ShedPercent;
+
+    if (0==memory)
+        memory=(uint64_t)sysconf(_SC_PHYS_PAGES) * (uint64_t)sysconf(_SC_PAGE_SIZE);
+
+    rss=ReadResidentMemory();
+    high=(memory / 100) * m_HighWatermark;
+
+    if (0==rss)
+        return;
+
+    if (high<rss && shed<75)
+        ShedLocked(shed+25);
+    else if (rss<(high / 10) * 9 && 0!=shed)
+        ShedLocked(shed<10 ? 0 : shed/2);
+
+}   // MemoryGovernor::CheckWatermark
+
+
+/**
+ * Runs on a worker thread, see RebalanceTask.
+ */
+void
+MemoryGovernor::Rebalance()
+{
+    std::vector<DbObject *> dbs;
+    std::vector<DbObject *>::iterator it;
+    std::vector<uint64_t> tasks;
+    uint64_t used(0), total_tasks(0), budget, even_share, busy_share;
+    size_t loop;
+    time_t now;
+
+    // container may have been resized since the last rebalance
+    CheckCgroupLimit();
+    CheckWatermark();
+    budget=m_Budget;
+
+    GetDbs(dbs);
+    now=time(NULL);
+
+    for (it=dbs.begin(); dbs.end()!=it; ++it)
+    {
+        DbMemory & mem((*it)->m_Memory);
+        uint64_t count((*it)->m_TaskCount);
+
+        // idle iterators pin snapshots and files, see DbObject::m_ItrIdleClose
+        if (0!=DbObject::m_ItrIdleClose)
+            (*it)->CloseIdleIterators(now, DbObject::m_ItrIdleClose);
+
+        Measure(*it);
+        used+=mem.Used();
+
+        tasks.push_back(count - mem.m_Tasks);
+        total_tasks+=tasks.back();
+        mem.m_Tasks=count;
+    }   // for
+
+    if (!dbs.empty())
+    {
+        even_share=budget / 2 / dbs.size();
+        busy_share=budget / 2;
+
+        for (loop=0; loop<dbs.size(); ++loop)
+        {
+            DbMemory & mem(dbs[loop]->m_Memory);
+
+            // no tasks anywhere:  busy half is split evenly too
+            if (0!=total_tasks)
+                mem.m_Budget=even_share + (uint64_t)((double)busy_share * tasks[loop] / total_tasks);
+            else
+                mem.m_Budget=even_share * 2;
+
+            // 0 budget is unknown (no total_memory, no cgroup limit),
+            //  leveldb sizes its own caches and the wrapper pools stay
+            if (0!=budget && mem.m_Budget < mem.Used())
+                dbs[loop]->DrainWrapperPool();
+
+            dbs[loop]->RefDec();
+        }   // for
+    }   // if
+
+    m_Used=used;
+    leveldb::inc_and_fetch(&m_Rebalances);
+    Reschedule();
+
+}   // MemoryGovernor::Rebalance
+
+}   // namespace eleveldb
@@ -0,0 +1,175 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_GOVERNOR_H
+#define INCL_GOVERNOR_H
+
+#include <stdint.h>
+#include <set>
+#include <vector>
+
+#include "port/port.h"
+
+namespace eleveldb {
+
+class DbObject;
+
+
+// Memory limit of this process's cgroup (v2 memory.max or v1
+//  memory.limit_in_bytes, smallest along the path to the root).
+//  0 if unlimited, not below physical memory, or not Linux.
+uint64_t ReadCgroupMemoryLimit();
+
+// resident memory of this process (all of the Erlang VM), 0 if not known
+uint64_t ReadResidentMemory();
+
+
+/**
+ * Memory of one database measured by the last rebalance.  Written
+ *  only by MemoryGovernor::Rebalance(), read without locks.
+ */
+struct DbMemory
+{
+    volatile uint64_t m_BlockCache;   //!< "leveldb.block-cache" bytes
+    volatile uint64_t m_FileCache;    //!< "leveldb.file-cache" bytes
+    volatile uint64_t m_MemTable;     //!< memtable bytes, write_buffer_size if not reported
+    volatile uint64_t m_Budget;       //!< this database's share of the node budget
+    uint64_t m_Tasks;                 //!< DbObject::m_TaskCount at last rebalance
+
+    DbMemory()
+        : m_BlockCache(0), m_FileCache(0), m_MemTable(0), m_Budget(0), m_Tasks(0)
+    {};
+
+    uint64_t Used() const {return(m_BlockCache + m_FileCache + m_MemTable);};
+};  // struct DbMemory
+
+
+/**
+ * One memory budget (total_leveldb_mem) for all open databases.
+ *  Every open database registers here.  A periodic rebalance,
+ *  run as a worker task, measures each database's caches and
+ *  memtable and divides the budget:  half evenly, half by each
+ *  database's share of the tasks since the previous rebalance.
+ *
+ * The budget follows total_memory from the open options, or the
+ *  process's cgroup memory limit when that is smaller or total_memory
+ *  was not given.  The limit is read at load and again by each
+ *  rebalance, so leveldb's caches follow a container resize.
+ *
+ * Under memory pressure part of the budget can be shed, see Shed().
+ *  With a high watermark set, each rebalance compares the process's
+ *  resident memory with it and sheds or restores on its own.
+ *
+ * leveldb sizes write buffers at open and divides its caches
+ *  itself once told the node total (leveldb::gFlexCache), so the
+ *  per database budgets steer what eleveldb holds:  a database
+ *  over its budget loses its pooled iterator wrappers, which pin
+ *  memtables and table files.  A 0 budget (no total_memory and no
+ *  container limit) leaves sizing to leveldb and drains nothing.
+ *  The same sweep closes iterators
+ *  idle past iterator_idle_close, see DbObject::CloseIdleIterators().
+ */
+class MemoryGovernor
+{
+protected:
+    leveldb::port::Mutex m_DbMutex;       //!< guards m_Dbs
+    std::set<DbObject *> m_Dbs;           //!< open databases
+
+    leveldb::port::Mutex m_BudgetMutex;   //!< guards budget inputs, UpdateBudget() and Shed()
+
+    uint64_t m_TotalMem;                  //!< total_leveldb_mem load option, 0 if none
+    int m_TotalMemPercent;                //!< total_leveldb_mem_percent load option, 0 if none
+    volatile uint64_t m_TotalMemory;      //!< total_memory open option, 0 if none
+    volatile uint64_t m_CgroupLimit;      //!< ReadCgroupMemoryLimit() at last check
+
+    volatile uint64_t m_Memory;           //!< memory size the budget was based on
+    volatile uint32_t m_ShedPercent;      //!< part of budget given back, see Shed()
+    uint32_t m_HighWatermark;             //!< percent of memory that triggers shedding, 0 off
+    volatile uint64_t m_Reclaimed;        //!< bytes given back by all Shed() calls
+
+    volatile uint64_t m_Budget;           //!< bytes for all databases, after shedding
+    volatile uint64_t m_Used;             //!< measured total at last rebalance
+    volatile uint64_t m_Rebalances;       //!< completed Rebalance() calls
+    volatile uint64_t m_NextRebalance;    //!< TaskPool::NowMicros() when due, 0 while one runs
+    uint64_t m_IntervalMicros;            //!< 0 disables periodic rebalance
+
+public:
+    MemoryGovernor(uint32_t IntervalSeconds, uint64_t TotalMem, int TotalMemPercent,
+                   uint32_t HighWatermark=0);
+
+    virtual ~MemoryGovernor() {};
+
+    void Register(DbObject * DbPtr);
+
+    void Unregister(DbObject * DbPtr);
+
+    // total_memory open option, recomputes budget
+    void SetTotalMemory(uint64_t TotalMemory);
+
+    // re-read cgroup limit, recompute budget if it changed
+    bool CheckCgroupLimit();
+
+    // give back Percent of the budget and pooled iterators, 0 restores;
+    //  returns bytes the databases' caches and memtables shrank by
+    uint64_t Shed(uint32_t Percent);
+
+    uint64_t Budget() const {return(m_Budget);};
+    uint64_t CgroupLimit() const {return(m_CgroupLimit);};
+    uint32_t ShedPercent() const {return(m_ShedPercent);};
+    uint64_t Reclaimed() const {return(m_Reclaimed);};
+    uint64_t Used() const {return(m_Used);};
+    uint64_t RebalanceCount() const {return(m_Rebalances);};
+
+    // true for exactly one caller once the interval has passed
+    bool RebalanceDue();
+
+    // RebalanceDue() caller could not run the rebalance
+    void Reschedule();
+
+    void Rebalance();
+
+    // open databases, each with a reference the caller must RefDec()
+    void GetDbs(std::vector<DbObject *> & Dbs);
+
+protected:
+    void Measure(DbObject * DbPtr);
+
+    // budget from options and memory size, applied to leveldb's
+    //  shared caches when it changes.  Caller holds m_BudgetMutex
+    void UpdateBudget();
+
+    // Shed() body, caller holds m_BudgetMutex
+    uint64_t ShedLocked(uint32_t Percent);
+
+    // shed or restore by resident memory against m_HighWatermark
+    void CheckWatermark();
+
+private:
+    MemoryGovernor();
+    MemoryGovernor(const MemoryGovernor &);             // nocopy
+    MemoryGovernor & operator=(const MemoryGovernor &); // nocopyassign
+};  // class MemoryGovernor
+
+} // namespace eleveldb
+
+
+#endif  // INCL_GOVERNOR_H
@@ -0,0 +1,137 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_HISTOGRAM_H
+    #include "histogram.h"
+#endif
+
+#include <string.h>
+
+#include "leveldb/atomics.h"
+
+
+namespace eleveldb {
+
+LatencyHistogram::LatencyHistogram()
+    : m_Count(0), m_Max(0)
+{
+    memset((void *)m_Buckets, 0, sizeof(m_Buckets));
+
+}   // LatencyHistogram::LatencyHistogram
+
+
+void
+LatencyHistogram::Record(
+    uint64_t Micros)
+{
+    uint64_t old_max;
+
+    leveldb::inc_and_fetch(&m_Buckets[BucketIndex(Micros)]);
+    leveldb::inc_and_fetch(&m_Count);
+
+    do
+    {
+        old_max=m_Max;
+    } while(old_max<Micros && !leveldb::compare_and_swap(&m_Max, old_max, Micros));
+
+}   // LatencyHistogram::Record
+
+
+uint64_t
+LatencyHistogram::Percentile(
+    double Fraction) const
+{
+    uint64_t count, rank, seen, high, max;
+    unsigned loop;
+
+    count=m_Count;
+    max=m_Max;
+    if (0==count)
+        return(0);
+
+    rank=(uint64_t)(Fraction * count + 0.999999);
+    if (0==rank)
+        rank=1;
+
+    for (loop=0, seen=0; loop<eBucketCount; ++loop)
+    {
+        seen+=m_Buckets[loop];
+        if (rank<=seen)
+        {
+            high=BucketHigh(loop);
+            return(high<max ? high : max);
+        }   // if
+    }   // for
+
+    // buckets trail m_Count while a Record() is in progress
+    return(max);
+
+}   // LatencyHistogram::Percentile
+
+
+/**
+ * Values below 2*eSubCount have a bucket each.  Above that the top
+ *  eSubBits+1 bits of the value select the bucket.
+ */
+unsigned
+LatencyHistogram::BucketIndex(
+    uint64_t Micros)
+{
+    unsigned msb, shift, index;
+
+    if (Micros < 2*eSubCount)
+        return((unsigned)Micros);
+
+    for (msb=eSubBits+1; msb<63 && (Micros >> (msb+1)); ++msb)
+    {}
+
+    if (eMaxBits<msb)
+        return(eBucketCount-1);
+
+    shift=msb-eSubBits;
+    index=(msb-eSubBits+1)*eSubCount + (unsigned)((Micros >> shift) & (eSubCount-1));
+
+    return(index);
+
+}   // LatencyHistogram::BucketIndex
+
+
+// largest value that maps to Index
+uint64_t
+LatencyHistogram::BucketHigh(
+    unsigned Index)
+{
+    unsigned msb, shift;
+    uint64_t low;
+
+    if (Index < 2*eSubCount)
+        return(Index);
+
+    msb=Index/eSubCount + eSubBits - 1;
+    shift=msb-eSubBits;
+    low=((uint64_t)(eSubCount + Index%eSubCount)) << shift;
+
+    return(low + (((uint64_t)1 << shift) - 1));
+
+}   // LatencyHistogram::BucketHigh
+
+} // namespace eleveldb
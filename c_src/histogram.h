@@ -0,0 +1,88 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_HISTOGRAM_H
+#define INCL_HISTOGRAM_H
+
+#include <stdint.h>
+
+namespace eleveldb {
+
+/**
+ * Log-linear latency histogram in the style of HdrHistogram:  each
+ *  power of two range of microseconds is split into 16 equal
+ *  buckets, so a reported percentile is within 1/16 (6.25%) of the
+ *  true value.  Record() is lock free, readers see counters that
+ *  may be a few samples apart from each other.
+ */
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        eSubBits=4,                              //!< 16 buckets per power of two
+        eSubCount=1 << eSubBits,
+        eMaxBits=40,                             //!< about 12 days in microseconds
+        eBucketCount=(eMaxBits-eSubBits+2)*eSubCount
+    };
+
+protected:
+    volatile uint64_t m_Buckets[eBucketCount];
+    volatile uint64_t m_Count;
+    volatile uint64_t m_Max;
+
+public:
+    LatencyHistogram();
+
+    void Record(uint64_t Micros);
+
+    uint64_t Count() const {return(m_Count);};
+    uint64_t Max() const {return(m_Max);};
+
+    // smallest value with at least Fraction of samples at or below it, 0 if empty
+    uint64_t Percentile(double Fraction) const;
+
+protected:
+    static unsigned BucketIndex(uint64_t Micros);
+    static uint64_t BucketHigh(unsigned Index);
+
+private:
+    LatencyHistogram(const LatencyHistogram &);             // nocopy
+    LatencyHistogram & operator=(const LatencyHistogram &); // nocopyassign
+
+};  // class LatencyHistogram
+
+
+/**
+ * Time a task spent queued for a worker thread (submit to
+ *  dequeue) and time spent in DoWork() (dequeue to completion).
+ */
+struct TaskLatency
+{
+    LatencyHistogram m_Wait;
+    LatencyHistogram m_Service;
+};  // struct TaskLatency
+
+} // namespace eleveldb
+
+
+#endif  // INCL_HISTOGRAM_H
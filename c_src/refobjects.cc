@@ -28,9 +28,12 @@
     #include "workitems.h"
 #endif
 
+#include <sstream>
+
 #include "leveldb/atomics.h"
 #include "leveldb/cache.h"
 #include "leveldb/filter_policy.h"
+#include "db/snapshot.h"
 
 
 namespace eleveldb {
@@ -279,7 +282,11 @@ DbObject::DbObjectResourceCleanup(
 DbObject::DbObject(
     leveldb::DB * DbPtr,
     leveldb::Options * Options)
-    : m_Db(DbPtr), m_DbOptions(Options)
+    : m_Db(DbPtr), m_DbOptions(Options),
+      m_ItrRefreshes(0), m_ItrSnapshots(0), m_ItrPinnedBytes(0),
+      m_SeqScans(0), m_SeqScanBytes(0),
+      m_WrapperReuses(0), m_DirtyIO(false), m_HomeShard(0),
+      m_TaskCount(0), m_Governor(NULL), m_ItrIdleClosed(0)
 {
 }   // DbObject::DbObject
 
@@ -316,6 +323,10 @@ DbObject::Shutdown()
     bool again;
     ItrObject * itr_ptr;
 
+    // no new rebalance will pick up this database
+    if (NULL!=m_Governor)
+        m_Governor->Unregister(this);
+
     do
     {
         again=false;
@@ -347,6 +358,9 @@ DbObject::Shutdown()
         }   // if
     } while(again);
 
+    // pooled wrappers hold a reference to this
+    DrainWrapperPool();
+
     return;
 
 }   // DbObject::Shutdown
@@ -382,6 +396,177 @@ DbObject::RemoveReference(
 }   // DbObject::RemoveReference
 
 
+size_t DbObject::m_WrapperPoolMax(16);
+uint32_t DbObject::m_ItrIdleClose(0);
+
+
+/**
+ * Take an idle LevelIteratorWrapper from the pool,
+ *  NULL if pool is empty
+ */
+LevelIteratorWrapper *
+DbObject::PopWrapper()
+{
+    LevelIteratorWrapper * ret_ptr(NULL);
+
+    {
+        leveldb::MutexLock lock(&m_ItrMutex);
+
+        if (!m_WrapperPool.empty())
+        {
+            ret_ptr=m_WrapperPool.back();
+            m_WrapperPool.pop_back();
+        }   // if
+    }
+
+    if (NULL!=ret_ptr)
+        leveldb::inc_and_fetch(&m_WrapperReuses);
+
+    return(ret_ptr);
+
+}   // DbObject::PopWrapper
+
+
+/**
+ * Park an unreferenced LevelIteratorWrapper.  Returns false
+ *  if caller must delete it instead.
+ */
+bool
+DbObject::PushWrapper(
+    LevelIteratorWrapper * Wrapper)
+{
+    bool ret_flag(false);
+
+    leveldb::MutexLock lock(&m_ItrMutex);
+
+    // Shutdown() drains the pool after close is flagged,
+    //  nothing may be added after that
+    if (0==GetCloseRequested() && m_WrapperPool.size() < m_WrapperPoolMax)
+    {
+        m_WrapperPool.push_back(Wrapper);
+        ret_flag=true;
+    }   // if
+
+    return(ret_flag);
+
+}   // DbObject::PushWrapper
+
+
+void
+DbObject::DrainWrapperPool()
+{
+    std::vector<LevelIteratorWrapper *> pool;
+    std::vector<LevelIteratorWrapper *>::iterator it;
+
+    {
+        leveldb::MutexLock lock(&m_ItrMutex);
+        pool.swap(m_WrapperPool);
+    }
+
+    // delete outside lock, each destructor releases a reference to this
+    for (it=pool.begin(); pool.end()!=it; ++it)
+        delete *it;
+
+    return;
+
+}   // DbObject::DrainWrapperPool
+
+
+/**
+ * Run by the memory governor's periodic rebalance, or on request
+ *  by IdleCloseTask.  Same close
+ *  protocol as Shutdown(), except the claim happens under
+ *  m_ItrMutex:  an ItrObject still on m_ItrList has not started
+ *  its destructor, and once claimed Erlang cannot start one.
+ */
+size_t
+DbObject::CloseIdleIterators(
+    time_t Now,
+    uint32_t IdleSeconds)
+{
+    std::vector<ItrObject *> idle;
+    std::vector<ItrObject *>::iterator it;
+    std::list<ItrObject *>::iterator list_it;
+
+    {
+        leveldb::MutexLock lock(&m_ItrMutex);
+
+        for (list_it=m_ItrList.begin(); m_ItrList.end()!=list_it; )
+        {
+            LevelIteratorWrapper * wrap((*list_it)->m_Iter.get());
+
+            if (NULL!=wrap && wrap->m_LastMove + (time_t)IdleSeconds <= Now
+                && (*list_it)->ClaimCloseFromCThread())
+            {
+                idle.push_back(*list_it);
+                list_it=m_ItrList.erase(list_it);
+            }   // if
+            else
+            {
+                ++list_it;
+            }   // else
+        }   // for
+    }
+
+    // outside lock, close waits for the iterator's tasks to finish
+    for (it=idle.begin(); idle.end()!=it; ++it)
+    {
+        (*it)->m_Iter->LogIterator();
+        (*it)->ItrObject::InitiateCloseRequest();
+    }   // for
+
+    leveldb::add_and_fetch(&m_ItrIdleClosed, (uint64_t)idle.size());
+
+    return(idle.size());
+
+}   // DbObject::CloseIdleIterators
+
+
+/**
+ * Properties maintained by eleveldb instead of leveldb are tried
+ *  first, same text format as leveldb's own status properties.
+ *  Caller holds a reference and has checked m_Db.
+ */
+bool
+DbObject::GetProperty(
+    const leveldb::Slice & Name,
+    std::string * Value)
+{
+    bool ret_flag(false);
+
+    if (Name == leveldb::Slice("eleveldb.iterators"))
+    {
+        std::ostringstream out;
+        size_t count, pooled;
+
+        {
+            leveldb::MutexLock lock(&m_ItrMutex);
+            count=m_ItrList.size();
+            pooled=m_WrapperPool.size();
+        }
+
+        out << "iterators: " << count << "\n"
+            << "snapshots: " << leveldb::add_and_fetch(&m_ItrSnapshots, (uint64_t)0) << "\n"
+            << "refreshes: " << leveldb::add_and_fetch(&m_ItrRefreshes, (uint64_t)0) << "\n"
+            << "pinned_bytes: " << leveldb::add_and_fetch(&m_ItrPinnedBytes, (uint64_t)0) << "\n"
+            << "pooled: " << pooled << "\n"
+            << "pool_reuses: " << leveldb::add_and_fetch(&m_WrapperReuses, (uint64_t)0) << "\n"
+            << "sequential_scans: " << leveldb::add_and_fetch(&m_SeqScans, (uint64_t)0) << "\n"
+            << "sequential_bytes: " << leveldb::add_and_fetch(&m_SeqScanBytes, (uint64_t)0) << "\n"
+            << "idle_closed: " << leveldb::add_and_fetch(&m_ItrIdleClosed, (uint64_t)0) << "\n";
+        Value->assign(out.str());
+        ret_flag=true;
+    }   // if
+    else if (NULL!=m_Db)
+    {
+        ret_flag=m_Db->GetProperty(Name, Value);
+    }   // else if
+
+    return(ret_flag);
+
+}   // DbObject::GetProperty
+
+
 
 /**
  * Regenerative iterator object (malloc memory)
@@ -391,22 +576,321 @@ LevelIteratorWrapper::LevelIteratorWrapper(
     ItrObject * ItrPtr,
     bool KeysOnly,
     leveldb::ReadOptions & Options,
+    IteratorOptions & ItrOptions,
     ERL_NIF_TERM itr_ref)
-    : m_DbPtr(ItrPtr->m_DbPtr.get()), m_ItrPtr(ItrPtr), m_Snapshot(NULL), m_Iterator(NULL),
+    : m_DbPtr(ItrPtr->m_DbPtr.get()), m_Snapshot(NULL), m_Iterator(NULL),
       m_HandoffAtomic(0), m_KeysOnly(KeysOnly), m_PrefetchStarted(false),
       m_Options(Options), itr_ref(itr_ref),
       m_IteratorStale(0), m_StillUse(true),
-      m_IteratorCreated(0), m_LastLogReport(0), m_MoveCount(0), m_IsValid(false)
+      m_RefreshInterval(0), m_RefreshMoves(0),
+      m_RefreshBytes(0), m_MovesSinceRefresh(0), m_BytesSinceRefresh(0), m_Sequential(false),
+      m_NoSnapshot(false),
+      m_IteratorCreated(0), m_LastLogReport(0), m_MoveCount(0), m_LastMove(0),
+      m_SnapshotSeq(0), m_IsValid(false),
+      m_RingWorker(0), m_RingWaiting(0), m_RingStop(0), m_RingEnd(0),
+      m_Reposition(false), m_Reverse(false), m_Resume(false), m_ResumeReverse(false),
+      m_Positioned(false), m_QueueSeq(0), m_QueueActive(false)
+{
+    Activate(ItrPtr, KeysOnly, Options, ItrOptions, itr_ref);
+
+}   // LevelIteratorWrapper::LevelIteratorWrapper
+
+
+/**
+ * Set every per iterator field.  Object is either new or
+ *  came from DbObject's pool (no iterator, no snapshot, no ItrObject)
+ */
+void
+LevelIteratorWrapper::Activate(
+    ItrObject * ItrPtr,
+    bool KeysOnly,
+    leveldb::ReadOptions & Options,
+    IteratorOptions & ItrOptions,
+    ERL_NIF_TERM ItrRef)
 {
     struct timeval tv;
 
+    m_ItrPtr.assign(ItrPtr);
+    m_HandoffAtomic=0;
+    m_KeysOnly=KeysOnly;
+    m_PrefetchStarted=0;
+    m_Options=Options;
+    itr_ref=ItrRef;
+
+    m_RecentKey.clear();
+    m_IteratorStale=0;
+    m_StillUse=true;
+    m_RefreshInterval=ItrOptions.m_RefreshInterval;
+    m_RefreshMoves=ItrOptions.m_RefreshMoves;
+    m_RefreshBytes=ItrOptions.m_RefreshBytes;
+    m_MovesSinceRefresh=0;
+    m_BytesSinceRefresh=0;
+
+    m_Sequential=ItrOptions.m_Sequential;
+    m_NoSnapshot=ItrOptions.m_NoSnapshot;
+    if (m_Sequential)
+        leveldb::inc_and_fetch(&m_DbPtr->m_SeqScans);
+
     gettimeofday(&tv, NULL);
     m_IteratorCreated=tv.tv_sec;
     m_LastLogReport=tv.tv_sec;
+    m_MoveCount=0;
+    m_LastMove=tv.tv_sec;
+    m_IsValid=false;
+
+    // pooled ring keeps its slots (and their string buffers) if depth matches
+    if (1<ItrOptions.m_PrefetchDepth || 1<m_Ring.Depth())
+        m_Ring.SetDepth(ItrOptions.m_PrefetchDepth);
+    m_RingWorker=0;
+    m_RingWaiting=0;
+    m_RingStop=0;
+    m_RingEnd=0;
+    m_Reposition=false;
+    m_RepositionKey.clear();
+
+    m_Reverse=false;
+    m_Resume=ItrOptions.m_Resume;
+    m_ResumeReverse=ItrOptions.m_ResumeReverse;
+    m_ResumeKey=ItrOptions.m_ResumeKey;
+    m_Positioned=false;
+
+    {
+        leveldb::MutexLock lock(&m_QueueMutex);
+
+        m_MoveQueue.clear();
+        m_QueueSeq=0;
+        m_QueueActive=false;
+    }
 
     RebuildIterator();
 
-}   // LevelIteratorWrapper::LevelIteratorWrapper
+    return;
+
+}   // LevelIteratorWrapper::Activate
+
+
+/**
+ * First move after iterator_resume.  The resumed iterator sits
+ *  between the token's key and its neighbor:  a forward token puts
+ *  the iterator on first key after m_ResumeKey, a reverse token on
+ *  last key before it.  Does not assume m_ResumeKey still exists.
+ */
+void
+LevelIteratorWrapper::ResumePosition(
+    leveldb::Iterator * Itr)
+{
+    leveldb::Slice key_slice(m_ResumeKey);
+
+    Itr->Seek(key_slice);
+
+    if (m_ResumeReverse)
+    {
+        if (Itr->Valid())
+            Itr->Prev();
+        else
+            Itr->SeekToLast();
+    }   // if
+    else if (Itr->Valid() && Itr->key()==key_slice)
+    {
+        Itr->Next();
+    }   // else if
+
+    m_Resume=false;
+    m_Reverse=m_ResumeReverse;
+    m_Positioned=true;
+
+    return;
+
+}   // LevelIteratorWrapper::ResumePosition
+
+
+uint32_t
+LevelIteratorWrapper::RefDec()
+{
+    uint32_t cur_count;
+
+    cur_count=RefDecNoDelete();
+
+    if (0==cur_count)
+    {
+        // drop everything that pins leveldb versions or the
+        //  ItrObject, keep allocations for next user
+        PurgeIterator();
+        m_ItrPtr.assign(NULL);
+
+        if (NULL==m_DbPtr.get() || !m_DbPtr->PushWrapper(this))
+            delete this;
+    }   // if
+
+    return(cur_count);
+
+}   // LevelIteratorWrapper::RefDec
+
+
+/**
+ * Return prefetch ring to empty, start of sequence state.
+ *  Caller must own the producer side (RingClaim) or know
+ *  that no MoveTask is active.
+ */
+void
+LevelIteratorWrapper::RingReset()
+{
+    m_Ring.Clear();
+    m_RingWaiting=0;
+    m_RingStop=0;
+
+    // full fence on last write
+    leveldb::compare_and_swap(&m_RingEnd, 1, 0);
+
+    return;
+
+}   // LevelIteratorWrapper::RingReset
+
+
+/**
+ * Build Erlang reply from front of prefetch ring.  Called by
+ *  whichever thread won the m_RingWaiting race, or by Erlang thread
+ *  directly when the ring already holds entries.  Ring must not be
+ *  empty unless RingFinished().
+ */
+ERL_NIF_TERM
+LevelIteratorWrapper::RingReply(
+    ErlNifEnv * Env,
+    bool Stop)
+{
+    ERL_NIF_TERM ret_term, key_term, value_term;
+    unsigned char * buffer;
+
+    if (!m_Ring.IsEmpty())
+    {
+        PrefetchRing::Entry & entry(m_Ring.Front());
+
+        buffer=enif_make_new_binary(Env, entry.m_Key.size(), &key_term);
+        memcpy(buffer, entry.m_Key.data(), entry.m_Key.size());
+
+        if (m_KeysOnly)
+        {
+            ret_term=enif_make_tuple2(Env, ATOM_OK, key_term);
+        }   // if
+        else
+        {
+            buffer=enif_make_new_binary(Env, entry.m_Value.size(), &value_term);
+            memcpy(buffer, entry.m_Value.data(), entry.m_Value.size());
+            ret_term=enif_make_tuple3(Env, ATOM_OK, key_term, value_term);
+        }   // else
+
+        // leveldb iterator has moved beyond this key if anything
+        //  is left in ring or end was reached, next/prev must seek back
+        if (Stop)
+        {
+            m_Reposition=(1<m_Ring.Count() || RingFinished());
+            if (m_Reposition)
+                m_RepositionKey=entry.m_Key;
+        }   // if
+
+        m_Ring.Pop();
+    }   // if
+    else
+    {
+        // end of keys ends this prefetch sequence too
+        ret_term=enif_make_tuple2(Env, ATOM_ERROR, ATOM_INVALID_ITERATOR);
+        Stop=true;
+    }   // else
+
+    if (Stop)
+        RingReset();
+
+    return(ret_term);
+
+}   // LevelIteratorWrapper::RingReply
+
+
+/**
+ * Append an iterator_queue_move request and assign its id.  Returns
+ *  true if the queue was idle and the caller must submit a
+ *  QueueMoveTask to drain it.
+ */
+bool
+LevelIteratorWrapper::QueuePush(
+    QueuedMove & Move)
+{
+    bool start;
+    leveldb::MutexLock lock(&m_QueueMutex);
+
+    Move.m_Id=++m_QueueSeq;
+    m_MoveQueue.push_back(QueuedMove());
+    m_MoveQueue.back().m_Id=Move.m_Id;
+    m_MoveQueue.back().m_Action=Move.m_Action;
+    m_MoveQueue.back().m_Count=Move.m_Count;
+    m_MoveQueue.back().m_Target.swap(Move.m_Target);
+    m_MoveQueue.back().m_Pid=Move.m_Pid;
+
+    start=!m_QueueActive;
+    m_QueueActive=true;
+
+    return(start);
+
+}   // LevelIteratorWrapper::QueuePush
+
+
+/**
+ * Take oldest queued request.  Returns false, and releases the
+ *  consumer side, once the queue is empty.
+ */
+bool
+LevelIteratorWrapper::QueuePop(
+    QueuedMove & Move)
+{
+    leveldb::MutexLock lock(&m_QueueMutex);
+
+    if (m_MoveQueue.empty())
+    {
+        m_QueueActive=false;
+        return(false);
+    }   // if
+
+    Move.m_Id=m_MoveQueue.front().m_Id;
+    Move.m_Action=m_MoveQueue.front().m_Action;
+    Move.m_Count=m_MoveQueue.front().m_Count;
+    Move.m_Target.swap(m_MoveQueue.front().m_Target);
+    Move.m_Pid=m_MoveQueue.front().m_Pid;
+    m_MoveQueue.pop_front();
+
+    return(true);
+
+}   // LevelIteratorWrapper::QueuePop
+
+
+/**
+ * True while a QueueMoveTask owns the iterator, direct moves
+ *  must wait for its replies
+ */
+bool
+LevelIteratorWrapper::QueueActive()
+{
+    leveldb::MutexLock lock(&m_QueueMutex);
+
+    return(m_QueueActive);
+
+}   // LevelIteratorWrapper::QueueActive
+
+
+/**
+ * QueueMoveTask could not be submitted.  Queue was idle before
+ *  QueuePush so only the failed request is dropped.
+ */
+void
+LevelIteratorWrapper::QueueAbort()
+{
+    leveldb::MutexLock lock(&m_QueueMutex);
+
+    m_MoveQueue.clear();
+    m_QueueActive=false;
+
+    return;
+
+}   // LevelIteratorWrapper::QueueAbort
+
 
 /**
  * put info about this iterator into leveldb LOG
@@ -429,6 +913,19 @@ LevelIteratorWrapper::LogIterator()
 }   // LevelIteratorWrapper::LogIterator()
 
 
+/**
+ * leveldb's public Snapshot is opaque, every one it hands out
+ *  is a SnapshotImpl
+ */
+uint64_t
+LevelIteratorWrapper::SnapshotSequence(
+    const leveldb::Snapshot * Snap)
+{
+    return(NULL!=Snap ? static_cast<const leveldb::SnapshotImpl *>(Snap)->number_ : 0);
+
+}   // LevelIteratorWrapper::SnapshotSequence
+
+
 /**
  * Iterator management object (Erlang memory)
  */
@@ -534,7 +1031,7 @@ ItrObject::ItrObject(
     bool KeysOnly,
     leveldb::ReadOptions & Options)
     : keys_only(KeysOnly), m_ReadOptions(Options), reuse_move(NULL),
-      m_DbPtr(DbPtr), itr_ref_env(NULL)
+      m_DbPtr(DbPtr), owner_pid(0), itr_ref_env(NULL)
 {
     if (NULL!=DbPtr)
         DbPtr->AddReference(this);
@@ -572,14 +1069,46 @@ ItrObject::Shutdown()
     //   release when move object destructs)
     ReleaseReuseMove();
 
-    // ItrObject and m_Iter each hold pointers to other, release ours
-    m_Iter.assign(NULL);
+    // ItrObject and m_Iter each hold pointers to other, release ours.
+    //  DbObject reads m_Iter of listed iterators under m_ItrMutex,
+    //  the last release (which may lock m_ItrMutex to pool the
+    //  wrapper) happens after unlock
+    if (NULL!=m_DbPtr.get())
+    {
+        ReferencePtr<LevelIteratorWrapper> hold(m_Iter.get());
+
+        leveldb::MutexLock lock(&m_DbPtr->m_ItrMutex);
+        m_Iter.assign(NULL);
+    }   // if
+    else
+    {
+        m_Iter.assign(NULL);
+    }   // else
 
     return;
 
 }   // ItrObject::Shutdown
 
 
+bool
+ItrObject::HoldIterator(
+    ReferencePtr<LevelIteratorWrapper> & Hold)
+{
+    if (NULL!=m_DbPtr.get())
+    {
+        leveldb::MutexLock lock(&m_DbPtr->m_ItrMutex);
+        Hold.assign(m_Iter.get());
+    }   // if
+    else
+    {
+        Hold.assign(m_Iter.get());
+    }   // else
+
+    return(NULL!=Hold.get());
+
+}   // ItrObject::HoldIterator
+
+
 bool
 ItrObject::ReleaseReuseMove()
 {
@@ -599,6 +1128,216 @@ ItrObject::ReleaseReuseMove()
 }   // ItrObject::ReleaseReuseMove()
 
 
+/**
+ * Merge iterator management object (Erlang memory)
+ */
+
+ErlNifResourceType * MergeItrObject::m_Merge_RESOURCE(NULL);
+
+
+void
+MergeItrObject::CreateMergeItrObjectType(
+    ErlNifEnv * Env)
+{
+    ErlNifResourceFlags flags = (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER);
+
+    m_Merge_RESOURCE = enif_open_resource_type(Env, NULL, "eleveldb_MergeItrObject",
+                                               &MergeItrObject::MergeItrObjectResourceCleanup,
+                                               flags, NULL);
+
+    return;
+
+}   // MergeItrObject::CreateMergeItrObjectType
+
+
+void *
+MergeItrObject::CreateMergeItrObject(
+    bool KeysOnly)
+{
+    MergeItrObject * ret_ptr;
+    void * alloc_ptr;
+
+    // the alloc call initializes the reference count to "one"
+    alloc_ptr=enif_alloc_resource(m_Merge_RESOURCE, sizeof(MergeItrObject *));
+
+    ret_ptr=new MergeItrObject(KeysOnly);
+    *(MergeItrObject **)alloc_ptr=ret_ptr;
+
+    // reference held by Erlang resource, released in cleanup
+    ret_ptr->RefInc();
+
+    return(alloc_ptr);
+
+}   // MergeItrObject::CreateMergeItrObject
+
+
+MergeItrObject *
+MergeItrObject::RetrieveMergeItrObject(
+    ErlNifEnv * Env,
+    const ERL_NIF_TERM & MergeTerm)
+{
+    MergeItrObject ** merge_ptr_ptr, * ret_ptr;
+
+    ret_ptr=NULL;
+
+    if (enif_get_resource(Env, MergeTerm, m_Merge_RESOURCE, (void **)&merge_ptr_ptr))
+        ret_ptr=*merge_ptr_ptr;
+
+    return(ret_ptr);
+
+}   // MergeItrObject::RetrieveMergeItrObject
+
+
+void
+MergeItrObject::MergeItrObjectResourceCleanup(
+    ErlNifEnv * Env,
+    void * Arg)
+{
+    MergeItrObject * volatile * erl_ptr;
+    MergeItrObject * merge_ptr;
+
+    erl_ptr=(MergeItrObject * volatile *)Arg;
+    merge_ptr=*erl_ptr;
+
+    if (leveldb::compare_and_swap(erl_ptr, merge_ptr, (MergeItrObject *)NULL)
+        && NULL!=merge_ptr)
+    {
+        merge_ptr->RefDec();
+    }   // if
+
+    return;
+
+}   // MergeItrObject::MergeItrObjectResourceCleanup
+
+
+MergeItrObject::MergeItrObject(
+    bool KeysOnly)
+    : m_KeysOnly(KeysOnly)
+{
+}   // MergeItrObject::MergeItrObject
+
+
+MergeItrObject::~MergeItrObject()
+{
+    CloseSources();
+
+    return;
+
+}   // MergeItrObject::~MergeItrObject
+
+
+/**
+ * Releasing the last Erlang reference to each source ItrObject
+ *  runs ItrObjectResourceCleanup, which closes it.  Caller holds
+ *  m_MergeMutex or is the destructor.
+ */
+void
+MergeItrObject::CloseSources()
+{
+    std::vector<void *>::iterator it;
+
+    for (it=m_Sources.begin(); m_Sources.end()!=it; ++it)
+        enif_release_resource(*it);
+
+    m_Sources.clear();
+    m_Heap.clear();
+
+    return;
+
+}   // MergeItrObject::CloseSources
+
+
+/**
+ * Cancellation token object (Erlang memory)
+ */
+
+ErlNifResourceType * CancelObject::m_Cancel_RESOURCE(NULL);
+
+
+void
+CancelObject::CreateCancelObjectType(
+    ErlNifEnv * Env)
+{
+    ErlNifResourceFlags flags = (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER);
+
+    m_Cancel_RESOURCE = enif_open_resource_type(Env, NULL, "eleveldb_CancelObject",
+                                                &CancelObject::CancelObjectResourceCleanup,
+                                                flags, NULL);
+
+    return;
+
+}   // CancelObject::CreateCancelObjectType
+
+
+void *
+CancelObject::CreateCancelObject()
+{
+    CancelObject * ret_ptr;
+    void * alloc_ptr;
+
+    // the alloc call initializes the reference count to "one"
+    alloc_ptr=enif_alloc_resource(m_Cancel_RESOURCE, sizeof(CancelObject *));
+
+    ret_ptr=new CancelObject;
+    *(CancelObject **)alloc_ptr=ret_ptr;
+
+    // reference held by Erlang resource, released in cleanup
+    ret_ptr->RefInc();
+
+    return(alloc_ptr);
+
+}   // CancelObject::CreateCancelObject
+
+
+CancelObject *
+CancelObject::RetrieveCancelObject(
+    ErlNifEnv * Env,
+    const ERL_NIF_TERM & CancelTerm)
+{
+    CancelObject ** cancel_ptr_ptr, * ret_ptr;
+
+    ret_ptr=NULL;
+
+    if (enif_get_resource(Env, CancelTerm, m_Cancel_RESOURCE, (void **)&cancel_ptr_ptr))
+        ret_ptr=*cancel_ptr_ptr;
+
+    return(ret_ptr);
+
+}   // CancelObject::RetrieveCancelObject
+
+
+/**
+ * Tasks hold their own reference, a token garbage collected
+ *  by Erlang stays valid until those tasks are gone.
+ */
+void
+CancelObject::CancelObjectResourceCleanup(
+    ErlNifEnv * Env,
+    void * Arg)
+{
+    CancelObject * volatile * erl_ptr;
+    CancelObject * cancel_ptr;
+
+    erl_ptr=(CancelObject * volatile *)Arg;
+    cancel_ptr=*erl_ptr;
+
+    if (leveldb::compare_and_swap(erl_ptr, cancel_ptr, (CancelObject *)NULL)
+        && NULL!=cancel_ptr)
+    {
+        cancel_ptr->RefDec();
+    }   // if
+
+    return;
+
+}   // CancelObject::CancelObjectResourceCleanup
+
+
+CancelObject::CancelObject()
+    : m_Cancelled(0)
+{
+}   // CancelObject::CancelObject
+
+
 } // namespace eleveldb
 
 
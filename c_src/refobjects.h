@@ -24,7 +24,10 @@
 
 #include <stdint.h>
 #include <sys/time.h>
+#include <deque>
 #include <list>
+#include <string>
+#include <vector>
 
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
@@ -41,6 +44,14 @@
     #include "atoms.h"
 #endif
 
+#ifndef INCL_GOVERNOR_H
+    #include "governor.h"
+#endif
+
+#ifndef INCL_DBSTATS_H
+    #include "dbstats.h"
+#endif
+
 
 namespace eleveldb {
 
@@ -178,6 +189,30 @@ public:
     leveldb::port::Mutex m_ItrMutex;                         //!< mutex protecting m_ItrList
     std::list<class ItrObject *> m_ItrList;   //!< ItrObjects holding ref count to this
 
+    // iterator refresh statistics, reported via status "eleveldb.iterators"
+    volatile uint64_t m_ItrRefreshes;         //!< iterator rebuilds after creation
+    volatile uint64_t m_ItrSnapshots;         //!< snapshots currently held by iterators
+    volatile uint64_t m_ItrPinnedBytes;       //!< bytes read via current leveldb iterators
+    volatile uint64_t m_SeqScans;             //!< iterators created with {scan_mode, sequential}
+    volatile uint64_t m_SeqScanBytes;         //!< key/value bytes read by sequential iterators
+
+    // idle iterator wrappers kept for reuse, protected by m_ItrMutex
+    std::vector<class LevelIteratorWrapper *> m_WrapperPool;
+    volatile uint64_t m_WrapperReuses;        //!< iterators built on a pooled wrapper
+    static size_t m_WrapperPoolMax;           //!< pool limit per database, 0 disables pool
+
+    bool m_DirtyIO;                           //!< {dirty_io, true}: get/write/move on dirty I/O schedulers
+    volatile uint32_t m_HomeShard;            //!< TaskPool shard (NUMA node) + 1, 0 until first task
+
+    std::string m_DbName;                     //!< path given to open
+    volatile uint64_t m_TaskCount;            //!< tasks submitted for this database
+    DbMemory m_Memory;                        //!< usage and budget, see MemoryGovernor
+    MemoryGovernor * m_Governor;              //!< registered with, or NULL
+    DbCounters m_Counters;                    //!< gets, writes, moves and bytes, see eleveldb:db_stats/1
+
+    static uint32_t m_ItrIdleClose;           //!< seconds without a move before an iterator is closed, 0 never
+    volatile uint64_t m_ItrIdleClosed;        //!< iterators closed by CloseIdleIterators()
+
 protected:
     static ErlNifResourceType* m_Db_RESOURCE;
 
@@ -193,6 +228,21 @@ public:
 
     void RemoveReference(class ItrObject *);
 
+    // LevelIteratorWrapper pool
+    class LevelIteratorWrapper * PopWrapper();
+
+    bool PushWrapper(class LevelIteratorWrapper *);
+
+    void DrainWrapperPool();
+
+    // close iterators idle IdleSeconds or more, returns count closed.  Called
+    //  with m_ItrIdleClose by MemoryGovernor::Rebalance() (see eleveldb_memory_interval)
+    //  and by eleveldb:close_idle_iterators/2
+    size_t CloseIdleIterators(time_t Now, uint32_t IdleSeconds);
+
+    // eleveldb.* properties, then leveldb's own GetProperty()
+    bool GetProperty(const leveldb::Slice & Name, std::string * Value);
+
     static void CreateDbObjectType(ErlNifEnv * Env);
 
     static void * CreateDbObject(leveldb::DB * Db, leveldb::Options * DbOptions);
@@ -208,6 +258,117 @@ private:
 };  // class DbObject
 
 
+/**
+ * eleveldb specific iterator options.  Parsed from the same
+ *  Erlang option list as leveldb::ReadOptions.
+ */
+struct IteratorOptions
+{
+    size_t m_PrefetchDepth;          //!< entries held in prefetch ring, 0 or 1 is classic single prefetch
+
+    // iterator_refresh policy, any explicit setting enables iterator_refresh
+    bool m_RefreshPolicy;            //!< true if one of the settings below was given
+    uint32_t m_RefreshInterval;      //!< seconds between rebuilds, 0 disables time based refresh
+    uint64_t m_RefreshMoves;         //!< iterator moves between rebuilds, 0 disables
+    uint64_t m_RefreshBytes;         //!< key/value bytes read between rebuilds, 0 disables
+
+    bool m_Sequential;               //!< {scan_mode, sequential}: bulk scan, no cache fill, read ahead
+    bool m_NoSnapshot;               //!< {snapshot, none}: no registered snapshot, implies refresh
+
+    // {resume, Token} from iterator_resume, see MoveTask CONTINUATION
+    bool m_Resume;                   //!< true if token given
+    bool m_ResumeReverse;            //!< token recorded a backward scan
+    std::string m_ResumeKey;         //!< last key seen before token was made
+
+    IteratorOptions()
+        : m_PrefetchDepth(0), m_RefreshPolicy(false), m_RefreshInterval(300),
+          m_RefreshMoves(0), m_RefreshBytes(0), m_Sequential(false), m_NoSnapshot(false),
+          m_Resume(false), m_ResumeReverse(false)
+        {};
+};  // struct IteratorOptions
+
+
+/**
+ * Bounded ring of prefetched key/value pairs.  Exactly one producer
+ *  (MoveTask on eleveldb worker thread) and one consumer (Erlang thread
+ *  in async_iterator_move), so head and tail only need memory fences,
+ *  not locks.  Slot strings keep their capacity, so a cycling ring stops
+ *  allocating once warm.
+ */
+class PrefetchRing
+{
+public:
+    struct Entry
+    {
+        std::string m_Key;
+        std::string m_Value;
+    };
+
+protected:
+    std::vector<Entry> m_Entries;
+    uint32_t m_Mask;                 //!< m_Entries.size() is power of 2
+    volatile uint32_t m_Head;        //!< next slot to read, written only by consumer
+    volatile uint32_t m_Tail;        //!< next slot to write, written only by producer
+
+public:
+    PrefetchRing()
+        : m_Mask(0), m_Head(0), m_Tail(0)
+    {};
+
+    // only call before first use
+    void SetDepth(size_t Depth)
+    {
+        size_t size;
+
+        for (size=1; size<Depth; size<<=1);
+        m_Entries.resize(size);
+        m_Mask=size-1;
+        m_Head=0;
+        m_Tail=0;
+    };
+
+    size_t Depth() const {return(m_Entries.size());};
+
+    // memory fenced reads
+    uint32_t Count()
+        {return(leveldb::add_and_fetch(&m_Tail, (uint32_t)0) - leveldb::add_and_fetch(&m_Head, (uint32_t)0));};
+    bool IsEmpty() {return(0==Count());};
+    bool IsFull() {return(m_Entries.size()<=Count());};
+
+    // producer: fill Back() then Push() to publish
+    Entry & Back() {return(m_Entries[m_Tail & m_Mask]);};
+    void Push() {leveldb::inc_and_fetch(&m_Tail);};
+
+    // consumer: read Front() then Pop() to release slot
+    Entry & Front() {return(m_Entries[m_Head & m_Mask]);};
+    void Pop() {leveldb::inc_and_fetch(&m_Head);};
+
+    // only valid when producer is idle
+    void Clear() {m_Head=m_Tail;};
+
+private:
+    PrefetchRing(const PrefetchRing &);            // no copy
+    PrefetchRing& operator=(const PrefetchRing &); // no assignment
+
+};  // class PrefetchRing
+
+
+/**
+ * One iterator_queue_move request.  Held in LevelIteratorWrapper's
+ *  move queue until QueueMoveTask executes it.
+ */
+struct QueuedMove
+{
+    unsigned long m_Id;              //!< request id returned to Erlang
+    int m_Action;                    //!< MoveTask::action_t
+    size_t m_Count;                  //!< PACKED entry limit
+    std::string m_Target;            //!< SEEK key
+    ErlNifPid m_Pid;                 //!< process that queued the request, gets reply
+
+    QueuedMove() : m_Id(0), m_Action(0), m_Count(0) {};
+};  // struct QueuedMove
+
+
 /**
  * A self deleting wrapper to contain leveldb iterator.
  *   Used when an ItrObject needs to skip around and might
@@ -231,25 +392,66 @@ public:
 
     // only used if m_Options.iterator_refresh == true
     std::string m_RecentKey;                  //!< Most recent key returned
-    time_t m_IteratorStale;                   //!< time iterator should refresh
+    time_t m_IteratorStale;                   //!< time iterator should refresh, 0 if never
     bool m_StillUse;                          //!< true if no error or key end seen
-
-    // debug data for hung iteratos
+    uint32_t m_RefreshInterval;               //!< copy of IteratorOptions::m_RefreshInterval
+    uint64_t m_RefreshMoves;                  //!< copy of IteratorOptions::m_RefreshMoves
+    uint64_t m_RefreshBytes;                  //!< copy of IteratorOptions::m_RefreshBytes
+    uint64_t m_MovesSinceRefresh;             //!< iterator moves on current snapshot
+    uint64_t m_BytesSinceRefresh;             //!< key/value bytes read on current snapshot
+    bool m_Sequential;                        //!< copy of IteratorOptions::m_Sequential
+    bool m_NoSnapshot;                        //!< copy of IteratorOptions::m_NoSnapshot
+
+    // debug data for hung iteratos, also read by eleveldb:iterators/1
     time_t m_IteratorCreated;                 //!< time constructor called
     time_t m_LastLogReport;                   //!< LOG message was last written
     size_t m_MoveCount;                       //!< number of calls to MoveItem
+    volatile time_t m_LastMove;               //!< time of most recent MoveItem, creation if none
+    volatile uint64_t m_SnapshotSeq;          //!< sequence of m_Snapshot plus one, 0 if none held
 
     // read by Erlang thread, maintained by eleveldb MoveItem::DoWork
     volatile bool m_IsValid;                  //!< iterator state after last operation
 
+    // only used if m_Ring.Depth() > 1, all flags use uint32_t for Solaris CAS
+    PrefetchRing m_Ring;                      //!< entries read ahead of Erlang
+    volatile uint32_t m_RingWorker;           //!< 1 while a MoveTask owns m_Ring's producer side
+    volatile uint32_t m_RingWaiting;          //!< 1 Erlang awaits next entry, 2 awaits prefetch_stop reply
+    volatile uint32_t m_RingStop;             //!< 1 after prefetch_stop, filler quits early
+    volatile uint32_t m_RingEnd;              //!< 1 after filler hit end of keys
+    bool m_Reposition;                        //!< iterator is not where Erlang thinks it is
+    std::string m_RepositionKey;              //!< last key Erlang saw, seek here before next/prev
+
+    // continuation token support
+    bool m_Reverse;                           //!< last positioning move was last or prev
+    bool m_Resume;                            //!< iterator_resume position not applied yet
+    bool m_ResumeReverse;                     //!< copy of IteratorOptions::m_ResumeReverse
+    std::string m_ResumeKey;                  //!< copy of IteratorOptions::m_ResumeKey
+    bool m_Positioned;                        //!< iterator already on entry next step returns
+
+    // pipelined moves, all protected by m_QueueMutex
+    leveldb::port::Mutex m_QueueMutex;
+    std::deque<QueuedMove> m_MoveQueue;       //!< requests not yet started, oldest first
+    unsigned long m_QueueSeq;                 //!< id of most recent queued request
+    bool m_QueueActive;                       //!< a QueueMoveTask owns m_MoveQueue's consumer side
+
     LevelIteratorWrapper(ItrObject * ItrPtr, bool KeysOnly,
-                         leveldb::ReadOptions & Options, ERL_NIF_TERM itr_ref);
+                         leveldb::ReadOptions & Options, IteratorOptions & ItrOptions,
+                         ERL_NIF_TERM itr_ref);
 
     virtual ~LevelIteratorWrapper()
     {
         PurgeIterator();
     }   // ~LevelIteratorWrapper
 
+    // (re)initialize for a new ItrObject, used by constructor and
+    //  when taken from DbObject's wrapper pool
+    void Activate(ItrObject * ItrPtr, bool KeysOnly,
+                  leveldb::ReadOptions & Options, IteratorOptions & ItrOptions,
+                  ERL_NIF_TERM itr_ref);
+
+    // last reference returns object to DbObject's pool instead of delete
+    virtual uint32_t RefDec();
+
     leveldb::Iterator * get() {return(m_Iterator);};
 
     volatile bool Valid() {return(m_IsValid);};
@@ -268,10 +470,17 @@ public:
             const leveldb::Snapshot * temp_snap(m_Snapshot);
 
             m_Snapshot=NULL;
+            m_SnapshotSeq=0;
             // leveldb performs actual "delete" call on m_Shapshot's pointer
             m_DbPtr->m_Db->ReleaseSnapshot(temp_snap);
+
+            leveldb::dec_and_fetch(&m_DbPtr->m_ItrSnapshots);
         }   // if
 
+        leveldb::sub_and_fetch(&m_DbPtr->m_ItrPinnedBytes, m_BytesSinceRefresh);
+        m_MovesSinceRefresh=0;
+        m_BytesSinceRefresh=0;
+
         if (NULL!=m_Iterator)
         {
             leveldb::Iterator * temp_iter(m_Iterator);
@@ -286,17 +495,96 @@ public:
         struct timeval tv;
 
         gettimeofday(&tv, NULL);
-        m_IteratorStale=tv.tv_sec + 300; // +5min
+        m_IteratorStale=(0!=m_RefreshInterval ? tv.tv_sec + m_RefreshInterval : 0);
 
         PurgeIterator();
-        m_Snapshot = m_DbPtr->m_Db->GetSnapshot();
+        if (!m_NoSnapshot)
+        {
+            m_Snapshot = m_DbPtr->m_Db->GetSnapshot();
+            m_SnapshotSeq = SnapshotSequence(m_Snapshot) + 1;
+            leveldb::inc_and_fetch(&m_DbPtr->m_ItrSnapshots);
+        }   // if
         m_Options.snapshot = m_Snapshot;
         m_Iterator = m_DbPtr->m_Db->NewIterator(m_Options);
     }   // RebuildIterator
 
+    // does iterator_refresh policy call for RebuildIterator()
+    bool RefreshDue(time_t Now) const
+    {
+        return((0!=m_IteratorStale && m_IteratorStale < Now)
+               || (0!=m_RefreshMoves && m_RefreshMoves <= m_MovesSinceRefresh)
+               || (0!=m_RefreshBytes && m_RefreshBytes <= m_BytesSinceRefresh));
+    }   // RefreshDue
+
+    // account for one iterator step against the refresh policy
+    void CountMove(leveldb::Iterator * Itr)
+    {
+        ++m_MovesSinceRefresh;
+        m_DbPtr->m_Counters.Add(eDbMoves);
+        if (Itr->Valid())
+        {
+            uint64_t bytes(Itr->key().size() + Itr->value().size());
+
+            m_BytesSinceRefresh+=bytes;
+            m_DbPtr->m_Counters.Add(eDbBytesOut, bytes);
+            leveldb::add_and_fetch(&m_DbPtr->m_ItrPinnedBytes, bytes);
+            if (m_Sequential)
+                leveldb::add_and_fetch(&m_DbPtr->m_SeqScanBytes, bytes);
+        }   // if
+    }   // CountMove
+
+    // place iterator next to m_ResumeKey, sets m_Positioned
+    void ResumePosition(leveldb::Iterator * Itr);
+
+    // true if a step in this direction must not move the iterator
+    //  because ResumePosition already did.  Always consumes m_Positioned.
+    bool TakePositioned(leveldb::Iterator * Itr, bool Reverse)
+    {
+        bool ret_flag(m_Positioned && Reverse==m_ResumeReverse);
+
+        // opposite direction from an iterator parked past either end
+        if (m_Positioned && !ret_flag && !Itr->Valid())
+        {
+            if (Reverse)
+                Itr->SeekToLast();
+            else
+                Itr->SeekToFirst();
+            ret_flag=true;
+        }   // if
+
+        m_Positioned=false;
+        return(ret_flag);
+    }   // TakePositioned
+
     // hung iterator debug
     void LogIterator();
 
+    // leveldb sequence number a snapshot reads at
+    static uint64_t SnapshotSequence(const leveldb::Snapshot * Snap);
+
+    // a worker owns the leveldb iterator:  classic prefetch running
+    //  or parked, a move awaiting its reply, or a prefetch ring sequence
+    bool MoveBusy()
+    {
+        return(0!=leveldb::add_and_fetch(&m_HandoffAtomic, (uint32_t)0)
+               || 0!=m_PrefetchStarted
+               || (1<m_Ring.Depth()
+                   && (0!=m_RingWorker || 0!=m_RingWaiting || !m_Ring.IsEmpty())));
+    }   // MoveBusy
+
+    // prefetch ring routines
+    bool RingClaim() {return(leveldb::compare_and_swap(&m_RingWorker, 0, 1));};
+    void RingRelease() {leveldb::compare_and_swap(&m_RingWorker, 1, 0);};
+    bool RingFinished() {return(0!=leveldb::add_and_fetch(&m_RingEnd, (uint32_t)0));};
+    void RingReset();
+    ERL_NIF_TERM RingReply(ErlNifEnv * Env, bool Stop);
+
+    // move queue routines
+    bool QueuePush(QueuedMove & Move);
+    bool QueueActive();
+    bool QueuePop(QueuedMove & Move);
+    void QueueAbort();
+
 private:
     LevelIteratorWrapper(const LevelIteratorWrapper &);            // no copy
     LevelIteratorWrapper& operator=(const LevelIteratorWrapper &); // no assignment
@@ -321,6 +609,7 @@ public:
     ReferencePtr<DbObject> m_DbPtr;
 
     ERL_NIF_TERM itr_ref;                  //!< what was caller ref to async_iterator
+    ERL_NIF_TERM owner_pid;                //!< process that called async_iterator, also in itr_ref_env
     ErlNifEnv *itr_ref_env;                //!< Erlang Env to hold itr_ref
 
 
@@ -345,6 +634,10 @@ public:
 
     bool ReleaseReuseMove();
 
+    // reference to m_Iter taken under the lock Shutdown() releases it
+    //  with, false once the iterator is closed (idle close runs on a worker)
+    bool HoldIterator(ReferencePtr<LevelIteratorWrapper> & Hold);
+
 private:
     ItrObject();
     ItrObject(const ItrObject &);            // no copy
@@ -352,6 +645,85 @@ private:
 
 };  // class ItrObject
 
+
+/**
+ * Ordered k-way merge across one ItrObject per database.  Created as
+ *  erlang reference.  Sources are kept as ItrObject Erlang resources,
+ *  not counted references, so a database close still shuts its
+ *  source down through DbObject::Shutdown.
+ */
+class MergeItrObject : public RefObject
+{
+public:
+    std::vector<void *> m_Sources;            //!< ItrObject resources, list order of databases
+    std::vector<size_t> m_Heap;               //!< m_Sources index of each valid iterator, smallest key at front
+    bool m_KeysOnly;                          //!< only return key values
+    leveldb::port::Mutex m_MergeMutex;        //!< one MergeMoveTask at a time
+
+protected:
+    static ErlNifResourceType* m_Merge_RESOURCE;
+
+public:
+    explicit MergeItrObject(bool KeysOnly);
+
+    virtual ~MergeItrObject();
+
+    // release all sources, later moves return iterator_closed
+    void CloseSources();
+
+    static void CreateMergeItrObjectType(ErlNifEnv * Env);
+
+    static void * CreateMergeItrObject(bool KeysOnly);
+
+    static MergeItrObject * RetrieveMergeItrObject(ErlNifEnv * Env, const ERL_NIF_TERM & MergeTerm);
+
+    static void MergeItrObjectResourceCleanup(ErlNifEnv *Env, void * Arg);
+
+private:
+    MergeItrObject();
+    MergeItrObject(const MergeItrObject &);            // no copy
+    MergeItrObject & operator=(const MergeItrObject &); // no assignment
+
+};  // class MergeItrObject
+
+
+/**
+ * Cancellation token for the {cancel, Token} option of get, write
+ *  and iterator_move.  Any number of tasks may share one token;
+ *  eleveldb:cancel(Token) marks it and workers drop those tasks
+ *  that have not started yet.
+ */
+class CancelObject : public RefObject
+{
+public:
+    volatile uint32_t m_Cancelled;            //!< 1 once cancel/1 called
+
+protected:
+    static ErlNifResourceType* m_Cancel_RESOURCE;
+
+public:
+    CancelObject();
+
+    virtual ~CancelObject() {};
+
+    void Cancel() {leveldb::compare_and_swap(&m_Cancelled, (uint32_t)0, (uint32_t)1);};
+
+    bool IsCancelled() const {return(0!=m_Cancelled);};
+
+    static void CreateCancelObjectType(ErlNifEnv * Env);
+
+    static void * CreateCancelObject();
+
+    static CancelObject * RetrieveCancelObject(ErlNifEnv * Env, const ERL_NIF_TERM & CancelTerm);
+
+    static void CancelObjectResourceCleanup(ErlNifEnv *Env, void * Arg);
+
+private:
+    CancelObject(const CancelObject &);            // no copy
+    CancelObject & operator=(const CancelObject &); // no assignment
+
+};  // class CancelObject
+
 } // namespace eleveldb
 
 
@@ -0,0 +1,626 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_TASKPOOL_H
+    #include "taskpool.h"
+#endif
+
+#ifndef INCL_WORKITEMS_H
+    #include "workitems.h"
+#endif
+
+#include <sys/time.h>
+
+#include "leveldb/atomics.h"
+#include "leveldb/env.h"
+#include "leveldb/perf_count.h"
+#include "util/mutexlock.h"
+
+
+namespace eleveldb {
+
+/**
+ * TaskClassStats functions
+ */
+
+void
+TaskClassStats::RecordWait(
+    uint64_t Micros)
+{
+    uint64_t old_max;
+
+    leveldb::inc_and_fetch(&m_Started);
+    leveldb::add_and_fetch(&m_WaitMicros, Micros);
+
+    do
+    {
+        old_max=m_WaitMax;
+    } while(old_max<Micros && !leveldb::compare_and_swap(&m_WaitMax, old_max, Micros));
+
+}   // TaskClassStats::RecordWait
+
+
+/**
+ * ShardSet functions
+ */
+
+ShardSet::ShardSet(
+    size_t Threads,
+    size_t Shards,
+    const std::vector<CpuList> & ShardCpus)
+    : m_Threads(0), m_Users(0), m_InFlight(0)
+{
+    size_t loop, count;
+    CpuList none;
+
+    m_Pools.reserve(Shards);
+
+    // spread remainder threads over the first shards
+    for (loop=0; loop<Shards; ++loop)
+    {
+        count=Threads/Shards + (loop < Threads%Shards ? 1 : 0);
+
+        // new threads inherit the creating thread's cpu mask
+        ThreadAffinity pin(ShardCpus.empty() ? none : ShardCpus[loop]);
+
+        m_Pools.push_back(new leveldb::HotThreadPool(count, "Eleveldb",
+                                                     leveldb::ePerfElevelDirect, leveldb::ePerfElevelQueued,
+                                                     leveldb::ePerfElevelDequeued, leveldb::ePerfElevelWeighted));
+        m_Threads+=count;
+    }   // for
+
+}   // ShardSet::ShardSet
+
+
+ShardSet::~ShardSet()
+{
+    std::vector<leveldb::HotThreadPool *>::iterator it;
+
+    // HotThreadPool destructor waits for running tasks
+    for (it=m_Pools.begin(); m_Pools.end()!=it; ++it)
+        delete *it;
+
+}   // ShardSet::~ShardSet
+
+
+/**
+ * True once no caller can still submit to m_Pools and
+ *  every task submitted here has finished.  A prefetch MoveTask
+ *  resubmits itself to the pool it ran on, bypassing TaskPool,
+ *  so an empty queue alone does not mean the set is idle.
+ */
+bool
+ShardSet::Drained() const
+{
+    std::vector<leveldb::HotThreadPool *>::const_iterator it;
+
+    if (0!=m_Users || 0!=m_InFlight)
+        return(false);
+
+    for (it=m_Pools.begin(); m_Pools.end()!=it; ++it)
+        if (0!=(*it)->work_queue_size())
+            return(false);
+
+    return(true);
+
+}   // ShardSet::Drained
+
+
+/**
+ * TaskPool functions
+ */
+
+TaskPool::TaskPool(
+    size_t Threads,
+    size_t Shards,
+    size_t BulkThreads,
+    size_t AdminThreads,
+    const CpuList & CpuSet,
+    bool Numa)
+    : m_Shards(NULL), m_ShardCount(Shards), m_RoundRobin(0), m_Resizes(0),
+      m_Retiring(0), m_NextReap(0),
+      m_Bulk(NULL), m_Admin(NULL),
+      m_BulkThreads(BulkThreads), m_AdminThreads(AdminThreads)
+{
+    std::vector<CpuList>::iterator it;
+
+    if (0==m_ShardCount)
+        m_ShardCount=1;
+
+    m_CpuSet=CpuSet;
+
+    if (Numa)
+    {
+        ReadNumaNodes(m_ShardCpus);
+
+        // nodes without any allowed cpu get no shard
+        for (it=m_ShardCpus.begin(); m_ShardCpus.end()!=it; )
+        {
+            if (!m_CpuSet.empty())
+                IntersectCpuList(*it, m_CpuSet);
+
+            if (it->empty())
+                it=m_ShardCpus.erase(it);
+            else
+                ++it;
+        }   // for
+
+        if (1<m_ShardCpus.size())
+            m_ShardCount=m_ShardCpus.size();
+        else
+            m_ShardCpus.clear();
+    }   // if
+
+    if (m_ShardCpus.empty() && !m_CpuSet.empty())
+        m_ShardCpus.assign(m_ShardCount, m_CpuSet);
+
+    if (Threads<m_ShardCount)
+        Threads=m_ShardCount;
+
+    m_Stats.resize(m_ShardCount);
+    m_Shards=new ShardSet(Threads, m_ShardCount, m_ShardCpus);
+
+    m_BulkBorrowLimit=(m_Shards->m_Threads+3)/4;
+
+    ThreadAffinity pin(m_CpuSet);
+
+    if (0!=BulkThreads)
+        m_Bulk=new leveldb::HotThreadPool(BulkThreads, "EleveldbBulk",
+                                          leveldb::ePerfElevelDirect, leveldb::ePerfElevelQueued,
+                                          leveldb::ePerfElevelDequeued, leveldb::ePerfElevelWeighted);
+
+    if (0!=AdminThreads)
+        m_Admin=new leveldb::HotThreadPool(AdminThreads, "EleveldbAdmin",
+                                           leveldb::ePerfElevelDirect, leveldb::ePerfElevelQueued,
+                                           leveldb::ePerfElevelDequeued, leveldb::ePerfElevelWeighted);
+
+}   // TaskPool::TaskPool
+
+
+TaskPool::~TaskPool()
+{
+    std::vector<ShardSet *>::iterator it;
+
+    delete m_Shards;
+
+    for (it=m_Retired.begin(); m_Retired.end()!=it; ++it)
+        delete *it;
+
+    delete m_Bulk;
+    delete m_Admin;
+
+}   // TaskPool::~TaskPool
+
+
+/**
+ * Swap in a new ShardSet with Threads threads.  Tasks already
+ *  queued on the old set still run there; ReapRetired() deletes
+ *  the old pools once they are drained.  The ShardSet
+ *  object itself is kept until ~TaskPool since AcquireShards()
+ *  may still touch its m_Users.
+ */
+bool
+TaskPool::SetThreads(
+    size_t Threads)
+{
+    ShardSet * old_set, * new_set;
+
+    if (0==Threads)
+        return(false);
+    if (Threads<m_ShardCount)
+        Threads=m_ShardCount;
+
+    {
+        leveldb::MutexLock lock(&m_ResizeMutex);
+
+        new_set=new ShardSet(Threads, m_ShardCount, m_ShardCpus);
+        old_set=m_Shards;
+
+        m_Shards=new_set;
+        m_BulkBorrowLimit=(new_set->m_Threads+3)/4;
+        m_Retired.push_back(old_set);
+        leveldb::inc_and_fetch(&m_Retiring);
+
+        // full barrier, publishes m_Shards before old set's m_Users is examined
+        leveldb::inc_and_fetch(&m_Resizes);
+    }
+
+    return(true);
+
+}   // TaskPool::SetThreads
+
+
+/**
+ * True at most every 10ms while a retired set still has its pools,
+ *  caller then submits a ReapTask.  Polled by every database and
+ *  iterator call (poll_governor), so no thread waits on a drain.
+ */
+bool
+TaskPool::ReapDue()
+{
+    uint64_t now, next;
+
+    if (0==leveldb::add_and_fetch(&m_Retiring, (uint32_t)0))
+        return(false);
+
+    now=NowMicros();
+    next=m_NextReap;
+
+    return(next<=now && leveldb::compare_and_swap(&m_NextReap, next, now + 10000));
+
+}   // TaskPool::ReapDue
+
+
+/**
+ * Runs as a WorkTask, which counts in flight on the set it runs
+ *  on, so it never joins its own thread.
+ */
+void
+TaskPool::ReapRetired()
+{
+    std::vector<leveldb::HotThreadPool *> pools;
+    std::vector<leveldb::HotThreadPool *>::iterator it;
+    std::vector<ShardSet *>::iterator set_it;
+
+    {
+        leveldb::MutexLock lock(&m_ResizeMutex);
+
+        for (set_it=m_Retired.begin(); m_Retired.end()!=set_it; ++set_it)
+        {
+            if (!(*set_it)->m_Pools.empty() && (*set_it)->Drained())
+            {
+                pools.insert(pools.end(), (*set_it)->m_Pools.begin(), (*set_it)->m_Pools.end());
+                (*set_it)->m_Pools.clear();
+                leveldb::dec_and_fetch(&m_Retiring);
+            }   // if
+        }   // for
+    }
+
+    // HotThreadPool destructor joins the drained threads
+    for (it=pools.begin(); pools.end()!=it; ++it)
+        delete *it;
+
+}   // TaskPool::ReapRetired
+
+
+size_t
+TaskPool::RetiringCount()
+{
+    size_t count(0);
+    std::vector<ShardSet *>::iterator it;
+    leveldb::MutexLock lock(&m_ResizeMutex);
+
+    for (it=m_Retired.begin(); m_Retired.end()!=it; ++it)
+        if (!(*it)->m_Pools.empty())
+            ++count;
+
+    return(count);
+
+}   // TaskPool::RetiringCount
+
+
+/**
+ * Pin the current ShardSet.  A set replaced between the read and
+ *  the increment is released again and the new one tried, so
+ *  SetThreads() can rely on m_Users of a replaced set only falling.
+ */
+ShardSet *
+TaskPool::AcquireShards()
+{
+    ShardSet * set;
+
+    while(true)
+    {
+        set=m_Shards;
+        leveldb::inc_and_fetch(&set->m_Users);
+
+        if (set==m_Shards)
+            break;
+
+        leveldb::dec_and_fetch(&set->m_Users);
+    }   // while
+
+    return(set);
+
+}   // TaskPool::AcquireShards
+
+
+void
+TaskPool::ReleaseShards(
+    ShardSet * Set)
+{
+    leveldb::dec_and_fetch(&Set->m_Users);
+
+}   // TaskPool::ReleaseShards
+
+
+size_t
+TaskPool::QueueDepth(
+    size_t Shard)
+{
+    size_t depth;
+    ShardSet * set(AcquireShards());
+
+    depth=set->m_Pools[Shard]->work_queue_size();
+    ReleaseShards(set);
+
+    return(depth);
+
+}   // TaskPool::QueueDepth
+
+
+/**
+ * Dispatch by Task's priority class, see class comment.
+ */
+bool
+TaskPool::Submit(
+    WorkTask * Task)
+{
+    bool ret_flag, queued;
+    TaskPriority priority;
+    TaskClassStats * stats;
+    ShardSet * set;
+
+    priority=Task->Priority();
+    if (ePriorityAdmin==priority && NULL==m_Admin)
+        priority=ePriorityInteractive;
+    if (ePriorityBulk==priority && NULL==m_Bulk)
+        priority=ePriorityInteractive;
+
+    // charge the class that actually runs the task, admin and bulk
+    //  work without their own threads counts as interactive
+    stats=&m_ClassStats[priority];
+    leveldb::inc_and_fetch(&stats->m_Submitted);
+    Task->SetSubmitted(stats, &m_Latency[Task->Type()], NowMicros());
+
+    // activity measure for MemoryGovernor::Rebalance()
+    if (NULL!=Task->GetDbObject())
+        leveldb::inc_and_fetch(&Task->GetDbObject()->m_TaskCount);
+
+    // a failed no-queue submit may release HotThreadPool's reference,
+    //  hold one here so Task survives for the next attempt
+    Task->RefInc();
+    queued=false;
+    set=AcquireShards();
+
+    switch(priority)
+    {
+        case ePriorityAdmin:
+            ret_flag=SubmitIdle(m_Admin, Task);
+            if (!ret_flag)
+                queued=ret_flag=m_Admin->Submit(Task, true);
+            break;
+
+        case ePriorityBulk:
+            ret_flag=SubmitIdle(m_Bulk, Task);
+
+            // borrow an idle shard thread only while interactive work is not waiting
+            if (!ret_flag && !ShardsQueued(set)
+                && leveldb::add_and_fetch(&stats->m_Borrowed, (uint64_t)0) < m_BulkBorrowLimit)
+            {
+                // mark first, the task could finish before Submit returns
+                Task->SetBorrowed(true);
+                ret_flag=SubmitShards(set, Task, false);
+                if (!ret_flag)
+                    Task->SetBorrowed(false);
+            }   // if
+
+            if (!ret_flag)
+                queued=ret_flag=m_Bulk->Submit(Task, true);
+            break;
+
+        case ePriorityInteractive:
+        default:
+            ret_flag=SubmitShards(set, Task, false);
+
+            if (!ret_flag && NULL!=m_Bulk)
+            {
+                Task->SetBorrowed(true);
+                ret_flag=SubmitIdle(m_Bulk, Task);
+                if (!ret_flag)
+                    Task->SetBorrowed(false);
+            }   // if
+
+            if (!ret_flag)
+                queued=ret_flag=SubmitShards(set, Task, true);
+            break;
+    }   // switch
+
+    ReleaseShards(set);
+
+    if (queued)
+        leveldb::inc_and_fetch(&stats->m_Queued);
+
+    // worker may already be done with Task, last RefDec deletes it.
+    //  On failure caller still owns (and deletes) Task.
+    if (ret_flag)
+        Task->RefDec();
+    else
+        Task->RefDecNoDelete();
+
+    return(ret_flag);
+
+}   // TaskPool::Submit
+
+
+/**
+ * Route task to its database's home shard.  HotThreadPool has no
+ *  way to take back queued work, so "stealing" happens at submit
+ *  time:  idle threads of other shards are tried before the task
+ *  waits in the home shard's queue.  Caller holds a reference to Task.
+ */
+bool
+TaskPool::SubmitShards(
+    ShardSet * Set,
+    WorkTask * Task,
+    bool OkToQueue)
+{
+    bool ret_flag;
+    size_t home, loop, shard;
+
+    home=HomeShard(Task->GetDbObject());
+
+    // count in flight before a thread can pick Task up and finish it
+    Task->SetShardSet(Set);
+
+    if (OkToQueue)
+    {
+        ret_flag=Set->m_Pools[home]->Submit(Task, true);
+        if (ret_flag)
+            leveldb::inc_and_fetch(&m_Stats[home].m_Queued);
+        else
+            Task->SetShardSet(NULL);
+        return(ret_flag);
+    }   // if
+
+    leveldb::inc_and_fetch(&m_Stats[home].m_Submitted);
+
+    ret_flag=SubmitIdle(Set->m_Pools[home], Task);
+    if (ret_flag)
+        leveldb::inc_and_fetch(&m_Stats[home].m_Direct);
+
+    for (loop=1; !ret_flag && loop<m_ShardCount; ++loop)
+    {
+        shard=(home+loop) % m_ShardCount;
+        ret_flag=SubmitIdle(Set->m_Pools[shard], Task);
+        if (ret_flag)
+            leveldb::inc_and_fetch(&m_Stats[shard].m_Stolen);
+    }   // for
+
+    if (!ret_flag)
+        Task->SetShardSet(NULL);
+
+    return(ret_flag);
+
+}   // TaskPool::SubmitShards
+
+
+/**
+ * Start Task only if one of Pool's threads is idle.
+ */
+bool
+TaskPool::SubmitIdle(
+    leveldb::HotThreadPool * Pool,
+    WorkTask * Task)
+{
+    return(Pool->Submit(Task, false));
+
+}   // TaskPool::SubmitIdle
+
+
+bool
+TaskPool::ShardsQueued(
+    ShardSet * Set) const
+{
+    std::vector<leveldb::HotThreadPool *>::const_iterator it;
+
+    for (it=Set->m_Pools.begin(); Set->m_Pools.end()!=it; ++it)
+        if (0!=(*it)->work_queue_size())
+            return(true);
+
+    return(false);
+
+}   // TaskPool::ShardsQueued
+
+
+size_t
+TaskPool::ClassThreads(
+    TaskPriority Class) const
+{
+    if (ePriorityBulk==Class)
+        return(m_BulkThreads);
+    if (ePriorityAdmin==Class)
+        return(m_AdminThreads);
+
+    return(ThreadCount());
+
+}   // TaskPool::ClassThreads
+
+
+size_t
+TaskPool::ClassQueueDepth(
+    TaskPriority Class)
+{
+    size_t depth(0);
+    std::vector<leveldb::HotThreadPool *>::const_iterator it;
+
+    if (ePriorityBulk==Class && NULL!=m_Bulk)
+        depth=m_Bulk->work_queue_size();
+    else if (ePriorityAdmin==Class && NULL!=m_Admin)
+        depth=m_Admin->work_queue_size();
+    else if (ePriorityInteractive==Class)
+    {
+        ShardSet * set(AcquireShards());
+
+        for (it=set->m_Pools.begin(); set->m_Pools.end()!=it; ++it)
+            depth+=(*it)->work_queue_size();
+
+        ReleaseShards(set);
+    }   // else if
+
+    return(depth);
+
+}   // TaskPool::ClassQueueDepth
+
+
+uint64_t
+TaskPool::NowMicros()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return((uint64_t)tv.tv_sec*1000000 + tv.tv_usec);
+
+}   // TaskPool::NowMicros
+
+
+/**
+ * A database gets its home shard on its first task, dealt round
+ *  robin so databases spread evenly over shards (NUMA nodes).  It
+ *  keeps that home, and so the node its memtables and cache blocks
+ *  were first touched on, for life.  Tasks without one rotate.
+ */
+size_t
+TaskPool::HomeShard(
+    DbObject * DbPtr)
+{
+    uint32_t home;
+
+    if (NULL==DbPtr)
+        return(leveldb::inc_and_fetch(&m_RoundRobin) % m_ShardCount);
+
+    home=DbPtr->m_HomeShard;
+    if (0==home)
+    {
+        home=leveldb::inc_and_fetch(&m_RoundRobin) % m_ShardCount + 1;
+
+        // a racing first task may have won, use its choice
+        if (!leveldb::compare_and_swap(&DbPtr->m_HomeShard, (uint32_t)0, home))
+            home=DbPtr->m_HomeShard;
+    }   // if
+
+    return((home-1) % m_ShardCount);
+
+}   // TaskPool::HomeShard
+
+} // namespace eleveldb
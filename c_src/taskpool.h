@@ -0,0 +1,241 @@
+// -------------------------------------------------------------------
+//
+// eleveldb: Erlang Wrapper for LevelDB (http://code.google.com/p/leveldb/)
+//
+// Copyright (c) 2011-2015 Basho Technologies, Inc. All Rights Reserved.
+//
+// This file is provided to you under the Apache License,
+// Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License.  You may obtain
+// a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// -------------------------------------------------------------------
+
+#ifndef INCL_TASKPOOL_H
+#define INCL_TASKPOOL_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "port/port.h"
+#include "util/hot_threads.h"
+
+#ifndef INCL_HISTOGRAM_H
+    #include "histogram.h"
+#endif
+
+#ifndef INCL_CPUSET_H
+    #include "cpuset.h"
+#endif
+
+namespace eleveldb {
+
+class WorkTask;
+class DbObject;
+
+
+/**
+ * Scheduling class of a WorkTask, see WorkTask::Priority()
+ */
+enum TaskPriority
+{
+    ePriorityInteractive=0,   //!< gets, writes, single iterator moves
+    ePriorityBulk=1,          //!< prefetch, packed and sequential scans
+    ePriorityAdmin=2,         //!< open, close, destroy:  may block for seconds
+    ePriorityCount=3
+};
+
+
+/**
+ * Latency histograms are kept per task type, see WorkTask::Type()
+ */
+enum TaskType
+{
+    eTaskGet=0,
+    eTaskWrite=1,
+    eTaskMove=2,          //!< iterator and merge iterator moves
+    eTaskOpen=3,
+    eTaskClose=4,         //!< database and iterator close
+    eTaskOther=5,         //!< iterator creation, destroy
+    eTaskTypeCount=6
+};
+
+
+/**
+ * Counters for one TaskPriority class.  All updated with atomics,
+ *  read without locks by status calls.
+ */
+struct TaskClassStats
+{
+    volatile uint64_t m_Submitted;  //!< tasks of this class given to Submit
+    volatile uint64_t m_Queued;     //!< ... that waited for a thread
+    volatile uint64_t m_Borrowed;   //!< tasks now running on another class's idle thread
+    volatile uint64_t m_Started;    //!< tasks that reached a worker thread
+    volatile uint64_t m_WaitMicros; //!< sum of submit to start times
+    volatile uint64_t m_WaitMax;    //!< longest submit to start time
+    volatile uint64_t m_RunMicros;  //!< sum of DoWork() times
+    volatile uint64_t m_Expired;    //!< tasks dropped because {deadline, Ms} passed
+    volatile uint64_t m_Cancelled;  //!< tasks dropped by eleveldb:cancel/1
+
+    TaskClassStats()
+        : m_Submitted(0), m_Queued(0), m_Borrowed(0), m_Started(0),
+          m_WaitMicros(0), m_WaitMax(0), m_RunMicros(0),
+          m_Expired(0), m_Cancelled(0)
+    {};
+
+    void RecordWait(uint64_t Micros);
+};  // struct TaskClassStats
+
+
+/**
+ * Counters for one TaskPool shard.  All updated with atomics,
+ *  read without locks by status calls.
+ */
+struct TaskShardStats
+{
+    volatile uint64_t m_Submitted;  //!< tasks whose database maps to this shard
+    volatile uint64_t m_Direct;     //!< ... started by an idle thread of this shard
+    volatile uint64_t m_Stolen;     //!< other shards' tasks started by an idle thread of this shard
+    volatile uint64_t m_Queued;     //!< ... queued here because no thread anywhere was idle
+
+    TaskShardStats()
+        : m_Submitted(0), m_Direct(0), m_Stolen(0), m_Queued(0)
+    {};
+};  // struct TaskShardStats
+
+
+/**
+ * The HotThreadPool of each shard.  A HotThreadPool cannot change
+ *  its thread count, so TaskPool::SetThreads() builds a new ShardSet
+ *  and retires the old one once nothing can still be submitted to it.
+ */
+struct ShardSet
+{
+    std::vector<leveldb::HotThreadPool *> m_Pools;
+    size_t m_Threads;               //!< total threads across m_Pools
+    volatile uint32_t m_Users;      //!< calls currently reading m_Pools
+    volatile uint32_t m_InFlight;   //!< tasks queued or running here, prefetch resubmits included
+
+    // ShardCpus empty, or one cpu list per shard for its threads
+    ShardSet(size_t Threads, size_t Shards, const std::vector<CpuList> & ShardCpus);
+
+    ~ShardSet();
+
+    bool Drained() const;
+
+private:
+    ShardSet();
+    ShardSet(const ShardSet &);             // nocopy
+    ShardSet & operator=(const ShardSet &); // nocopyassign
+};  // struct ShardSet
+
+
+/**
+ * eleveldb's worker threads.  With one shard this is the classic
+ *  single leveldb::HotThreadPool.  With several shards each database
+ *  (DbObject) maps to a home shard so its tasks tend to run on the
+ *  same few threads; a task whose home shard has no idle thread is
+ *  handed to an idle thread of another shard before it is queued.
+ *
+ * Bulk and admin tasks get their own reserved threads when
+ *  configured, otherwise they share the shards with interactive
+ *  tasks.  Interactive tasks may use an idle bulk thread.  Bulk tasks
+ *  may use idle shard threads while no interactive task is queued,
+ *  up to a quarter of the shard threads at once.
+ *
+ * The shard threads can be resized while tasks are in flight, see
+ *  SetThreads().
+ *
+ * All threads may be restricted to a cpu set.  With Numa, there is
+ *  one shard per NUMA node, its threads pinned to that node's cpus,
+ *  and each database's home shard is its home node.
+ */
+class TaskPool
+{
+protected:
+    ShardSet * volatile m_Shards;             //!< current shard pools, see AcquireShards()
+    size_t m_ShardCount;                      //!< fixed, resizing only changes threads per shard
+    CpuList m_CpuSet;                         //!< cpus for all threads, empty for any
+    std::vector<CpuList> m_ShardCpus;         //!< cpus of each shard, empty when not pinned
+    std::vector<TaskShardStats> m_Stats;      //!< one per shard
+    volatile uint32_t m_RoundRobin;           //!< home of tasks without a database
+
+    leveldb::port::Mutex m_ResizeMutex;       //!< one SetThreads() at a time, guards m_Retired
+    std::vector<ShardSet *> m_Retired;        //!< replaced sets still draining
+    volatile uint64_t m_Resizes;              //!< successful SetThreads() calls
+    volatile uint32_t m_Retiring;             //!< retired sets still holding their pools
+    volatile uint64_t m_NextReap;             //!< NowMicros() of next ReapDue(), rate limit
+
+    leveldb::HotThreadPool * m_Bulk;          //!< reserved bulk threads, or NULL
+    leveldb::HotThreadPool * m_Admin;         //!< reserved admin threads, or NULL
+    size_t m_BulkThreads;
+    size_t m_AdminThreads;
+    uint64_t m_BulkBorrowLimit;               //!< max bulk tasks on shard threads at once
+    TaskClassStats m_ClassStats[ePriorityCount];
+    TaskLatency m_Latency[eTaskTypeCount];
+
+public:
+    TaskPool(size_t Threads, size_t Shards, size_t BulkThreads=0, size_t AdminThreads=0,
+             const CpuList & CpuSet=CpuList(), bool Numa=false);
+
+    virtual ~TaskPool();
+
+    // same contract as HotThreadPool::Submit:  false means caller still owns Task
+    bool Submit(WorkTask * Task);
+
+    // replace shard threads with Threads new ones, old ones finish their queues first
+    bool SetThreads(size_t Threads);
+
+    size_t ShardCount() const {return(m_ShardCount);};
+    size_t ThreadCount() const {return(m_Shards->m_Threads);};
+    size_t QueueDepth(size_t Shard);
+    const TaskShardStats & Stats(size_t Shard) const {return(m_Stats[Shard]);};
+    size_t ShardCpuCount(size_t Shard) const {return(m_ShardCpus.empty() ? 0 : m_ShardCpus[Shard].size());};
+    uint64_t ResizeCount() const {return(m_Resizes);};
+    size_t RetiringCount();
+
+    // per TaskPriority class, reserved threads are 0 if class shares the shards
+    size_t ClassThreads(TaskPriority Class) const;
+    size_t ClassQueueDepth(TaskPriority Class);
+    const TaskClassStats & ClassStats(TaskPriority Class) const {return(m_ClassStats[Class]);};
+
+    const TaskLatency & Latency(TaskType Type) const {return(m_Latency[Type]);};
+
+    static uint64_t NowMicros();
+
+    // release pools of drained retired sets, see ReapTask
+    bool ReapDue();
+    void ReapRetired();
+
+protected:
+    ShardSet * AcquireShards();
+    void ReleaseShards(ShardSet * Set);
+
+    size_t HomeShard(DbObject * DbPtr);
+
+    bool SubmitShards(ShardSet * Set, WorkTask * Task, bool OkToQueue);
+
+    bool SubmitIdle(leveldb::HotThreadPool * Pool, WorkTask * Task);
+
+    bool ShardsQueued(ShardSet * Set) const;
+
+private:
+    TaskPool();
+    TaskPool(const TaskPool &);             // nocopy
+    TaskPool & operator=(const TaskPool &); // nocopyassign
+
+};  // class TaskPool
+
+} // namespace eleveldb
+
+
+#endif  // INCL_TASKPOOL_H
@@ -21,6 +21,10 @@
 // -------------------------------------------------------------------
 
 #include <syslog.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
 
 #ifndef INCL_WORKITEMS_H
     #include "workitems.h"
@@ -28,6 +32,8 @@
 
 #include "leveldb/atomics.h"
 #include "leveldb/cache.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/perf_count.h"
 
@@ -50,6 +56,21 @@ static ERL_NIF_TERM slice_to_binary(ErlNifEnv* env, leveldb::Slice s)
 }
 
 
+// write <<Len:32/big, Data/binary>> at offset, return offset past it
+static size_t pack_frame(unsigned char * buffer, size_t offset, const leveldb::Slice & s)
+{
+    uint32_t len(s.size());
+
+    buffer[offset++]=(unsigned char)(len >> 24);
+    buffer[offset++]=(unsigned char)(len >> 16);
+    buffer[offset++]=(unsigned char)(len >> 8);
+    buffer[offset++]=(unsigned char)len;
+    memcpy(buffer + offset, s.data(), s.size());
+
+    return(offset + s.size());
+}
+
+
 namespace eleveldb {
 
 
@@ -59,11 +80,12 @@ namespace eleveldb {
 
 
 WorkTask::WorkTask(ErlNifEnv *caller_env, ERL_NIF_TERM& caller_ref)
-    : terms_set(false)
+    : terms_set(false), m_ClassStats(NULL), m_Latency(NULL), m_SubmitMicros(0), m_Borrowed(false),
+      m_ShardSet(NULL), m_DeadlineMicros(0)
 {
     if (NULL!=caller_env)
     {
-        local_env_ = enif_alloc_env();
+        local_env_ = EnvPool::Alloc();
         caller_ref_term = enif_make_copy(local_env_, caller_ref);
         caller_pid_term = enif_make_pid(local_env_, enif_self(caller_env, &local_pid));
         terms_set=true;
@@ -80,11 +102,13 @@ WorkTask::WorkTask(ErlNifEnv *caller_env, ERL_NIF_TERM& caller_ref)
 
 
 WorkTask::WorkTask(ErlNifEnv *caller_env, ERL_NIF_TERM& caller_ref, DbObject * DbPtr)
-    : m_DbPtr(DbPtr), terms_set(false)
+    : m_DbPtr(DbPtr), terms_set(false),
+      m_ClassStats(NULL), m_Latency(NULL), m_SubmitMicros(0), m_Borrowed(false),
+      m_ShardSet(NULL), m_DeadlineMicros(0)
 {
     if (NULL!=caller_env)
     {
-        local_env_ = enif_alloc_env();
+        local_env_ = EnvPool::Alloc();
         caller_ref_term = enif_make_copy(local_env_, caller_ref);
         caller_pid_term = enif_make_pid(local_env_, enif_self(caller_env, &local_pid));
         terms_set=true;
@@ -110,7 +134,7 @@ WorkTask::~WorkTask()
     if (leveldb::compare_and_swap(&local_env_, env_ptr, (ErlNifEnv *)NULL)
         && NULL!=env_ptr)
     {
-        enif_free_env(env_ptr);
+        EnvPool::Free(env_ptr);
     }   // if
 
     return;
@@ -121,8 +145,48 @@ WorkTask::~WorkTask()
 void
 WorkTask::operator()()
 {
+    uint64_t start(0), wait, run;
+    ShardSet * shards;
+
+    // claim the in flight count now:  once DoWork() hands off a prefetch
+    //  result Erlang may submit this task again before operator() returns
+    shards=m_ShardSet;
+    m_ShardSet=NULL;
+
+    // resubmitted work (MoveTask prefetch) is not counted twice
+    if (NULL!=m_ClassStats)
+    {
+        start=TaskPool::NowMicros();
+        if (0!=m_SubmitMicros)
+        {
+            wait=(start>m_SubmitMicros ? start-m_SubmitMicros : 0);
+            m_ClassStats->RecordWait(wait);
+            m_Latency->m_Wait.Record(wait);
+            m_SubmitMicros=0;
+        }   // if
+    }   // if
+
+    // expired or cancelled while queued:  reply without touching leveldb
+    ERL_NIF_TERM reason(DropReason());
+
     // call the DoWork() method defined by the subclass
-    basho::async_nif::work_result result = DoWork();
+    basho::async_nif::work_result result = (0==reason ? DoWork() : DropWork(reason));
+
+    if (NULL!=m_ClassStats)
+    {
+        run=TaskPool::NowMicros();
+        run=(run>start ? run-start : 0);
+        leveldb::add_and_fetch(&m_ClassStats->m_RunMicros, run);
+        m_Latency->m_Service.Record(run);
+        SetBorrowed(false);
+    }   // if
+
+    // a resubmitted prefetch reruns on the same, maybe retired, pool
+    if (resubmit())
+        m_ShardSet=shards;
+    else if (NULL!=shards)
+        leveldb::dec_and_fetch(&shards->m_InFlight);
+
     if (result.is_set())
     {
         ErlNifPid pid;
@@ -140,6 +204,91 @@ WorkTask::operator()()
 }
 
 
+work_result
+WorkTask::RunDirect()
+{
+    ERL_NIF_TERM reason(DropReason());
+
+    return(0==reason ? DoWork() : DropWork(reason));
+
+}   // WorkTask::RunDirect
+
+
+/**
+ * Checked once a thread picks up the task.  Resubmitted work
+ *  (prefetch) is never given limits, see async_iterator_move.
+ */
+ERL_NIF_TERM
+WorkTask::DropReason()
+{
+    ERL_NIF_TERM reason(0);
+
+    if (NULL!=m_Cancel.get() && m_Cancel->IsCancelled())
+    {
+        reason=ATOM_CANCELLED;
+        if (NULL!=m_ClassStats)
+            leveldb::inc_and_fetch(&m_ClassStats->m_Cancelled);
+    }   // if
+    else if (0!=m_DeadlineMicros && m_DeadlineMicros<TaskPool::NowMicros())
+    {
+        reason=ATOM_TIMEOUT;
+        if (NULL!=m_ClassStats)
+            leveldb::inc_and_fetch(&m_ClassStats->m_Expired);
+    }   // else if
+
+    return(reason);
+
+}   // WorkTask::DropReason
+
+
+work_result
+WorkTask::DropWork(
+    ERL_NIF_TERM Reason)
+{
+    return(work_result(local_env(), ATOM_ERROR, Reason));
+
+}   // WorkTask::DropWork
+
+
+/**
+ * ShardSet::Drained() waits for every task counted here,
+ *  replaces (and uncounts) any previous set
+ */
+void
+WorkTask::SetShardSet(
+    ShardSet * Set)
+{
+    if (NULL!=m_ShardSet)
+        leveldb::dec_and_fetch(&m_ShardSet->m_InFlight);
+
+    m_ShardSet=Set;
+
+    if (NULL!=Set)
+        leveldb::inc_and_fetch(&Set->m_InFlight);
+
+}   // WorkTask::SetShardSet
+
+
+/**
+ * TaskPool counts tasks running on a thread reserved for another
+ *  priority class
+ */
+void
+WorkTask::SetBorrowed(
+    bool Flag)
+{
+    if (Flag!=m_Borrowed && NULL!=m_ClassStats)
+    {
+        m_Borrowed=Flag;
+        if (Flag)
+            leveldb::inc_and_fetch(&m_ClassStats->m_Borrowed);
+        else
+            leveldb::dec_and_fetch(&m_ClassStats->m_Borrowed);
+    }   // if
+
+}   // WorkTask::SetBorrowed
+
+
 /**
  * OpenTask functions
  */
@@ -148,9 +297,12 @@ OpenTask::OpenTask(
     ErlNifEnv* caller_env,
     ERL_NIF_TERM& _caller_ref,
     const std::string& db_name_,
-    leveldb::Options *open_options_)
+    leveldb::Options *open_options_,
+    bool dirty_io_,
+    MemoryGovernor * governor_)
     : WorkTask(caller_env, _caller_ref),
-    db_name(db_name_), open_options(open_options_)
+    db_name(db_name_), open_options(open_options_), dirty_io(dirty_io_),
+    governor(governor_)
 {
 }   // OpenTask::OpenTask
 
@@ -159,6 +311,7 @@ work_result
 OpenTask::DoWork()
 {
     void * db_ptr_ptr;
+    DbObject * db_obj;
     leveldb::DB *db(0);
 
     leveldb::Status status = leveldb::DB::Open(*open_options, db_name, &db);
@@ -167,6 +320,15 @@ OpenTask::DoWork()
         return error_tuple(local_env(), ATOM_ERROR_DB_OPEN, status);
 
     db_ptr_ptr=DbObject::CreateDbObject(db, open_options);
+    db_obj=*(DbObject **)db_ptr_ptr;
+    db_obj->m_DirtyIO=dirty_io;
+    db_obj->m_DbName=db_name;
+
+    if (NULL!=governor)
+    {
+        db_obj->m_Governor=governor;
+        governor->Register(db_obj);
+    }   // if
 
     // create a resource reference to send erlang
     ERL_NIF_TERM result = enif_make_resource(local_env(), db_ptr_ptr);
@@ -180,6 +342,56 @@ OpenTask::DoWork()
 
 
 
+/**
+ * WriteTask functions
+ */
+
+
+
+
+/**
+ * IterTask functions
+ */
+
+void *
+IterTask::CreateIterator(
+    DbObject * DbPtr,
+    bool KeysOnly,
+    leveldb::ReadOptions & Options,
+    IteratorOptions & ItrOptions,
+    ERL_NIF_TERM CallerRef,
+    ERL_NIF_TERM OwnerPid)
+{
+    ItrObject * itr_ptr;
+    LevelIteratorWrapper * wrap_ptr;
+    void * itr_ptr_ptr;
+
+    // NOTE: transfering ownership of options to ItrObject
+    itr_ptr_ptr=ItrObject::CreateItrObject(DbPtr, KeysOnly, Options);
+
+    // Copy caller_ref to reuse in future iterator_move calls
+    itr_ptr=*(ItrObject**)itr_ptr_ptr;
+    itr_ptr->itr_ref_env = enif_alloc_env();
+    itr_ptr->itr_ref = enif_make_copy(itr_ptr->itr_ref_env, CallerRef);
+    itr_ptr->owner_pid = enif_make_copy(itr_ptr->itr_ref_env, OwnerPid);
+
+    // reuse an idle wrapper when database has one
+    wrap_ptr=DbPtr->PopWrapper();
+    if (NULL!=wrap_ptr)
+        wrap_ptr->Activate(itr_ptr, KeysOnly, Options, ItrOptions,
+                           itr_ptr->itr_ref);
+    else
+        wrap_ptr=new LevelIteratorWrapper(itr_ptr, KeysOnly,
+                                          Options, ItrOptions,
+                                          itr_ptr->itr_ref);
+    itr_ptr->m_Iter.assign(wrap_ptr);
+
+    return(itr_ptr_ptr);
+
+}   // IterTask::CreateIterator
+
+
+
 /**
  * MoveTask functions
  */
@@ -204,10 +416,11 @@ MoveTask::DoWork()
 
         gettimeofday(&tv, NULL);
 
-        if (m_ItrWrap->m_IteratorStale < tv.tv_sec || NULL==itr)
+        if (m_ItrWrap->RefreshDue(tv.tv_sec) || NULL==itr)
         {
             m_ItrWrap->RebuildIterator();
             itr=m_ItrWrap->get();
+            leveldb::inc_and_fetch(&m_ItrWrap->m_DbPtr->m_ItrRefreshes);
 
             // recover position
             if (NULL!=itr && 0!=m_ItrWrap->m_RecentKey.size())
@@ -231,6 +444,8 @@ MoveTask::DoWork()
 
         gettimeofday(&tv, NULL);
 
+        m_ItrWrap->m_LastMove=tv.tv_sec;
+
         // 14400 is 4 hours in seconds ... 60*60*4
         if ((m_ItrWrap->m_LastLogReport + 14400) < tv.tv_sec && NULL!=m_ItrWrap->get())
         {
@@ -239,27 +454,68 @@ MoveTask::DoWork()
         }   // if
     }
 
+    // prefetch_stop left leveldb iterator ahead of what Erlang has seen
+    if (NULL!=itr && m_ItrWrap->m_Reposition)
+    {
+        m_ItrWrap->m_Reposition=false;
+
+        if (FIRST!=action && LAST!=action && SEEK!=action)
+        {
+            leveldb::Slice key_slice(m_ItrWrap->m_RepositionKey);
+
+            itr->Seek(key_slice);
+        }   // if
+    }   // if
+
+    // first move after iterator_resume
+    if (NULL!=itr && m_ItrWrap->m_Resume && CONTINUATION!=action)
+    {
+        if (FIRST!=action && LAST!=action && SEEK!=action)
+            m_ItrWrap->ResumePosition(itr);
+        else
+            m_ItrWrap->m_Resume=false;
+    }   // if
+
+    // prefetch ring replies by direct message, never by return value
+    if (1<m_ItrWrap->m_Ring.Depth() && (PREFETCH==action || PREFETCH_STOP==action))
+        return(FillRing(itr));
+
     // back to normal operation
     if(NULL == itr)
         return work_result(local_env(), ATOM_ERROR, ATOM_ITERATOR_CLOSED);
 
+    if (PACKED==action)
+        return(PackEntries(itr));
+
+    if (CONTINUATION==action)
+        return(MakeContinuation(itr));
+
     switch(action)
     {
-        case FIRST: itr->SeekToFirst(); break;
+        case FIRST: itr->SeekToFirst(); m_ItrWrap->m_Reverse=false; break;
 
-        case LAST:  itr->SeekToLast();  break;
+        case LAST:  itr->SeekToLast();  m_ItrWrap->m_Reverse=true;  break;
 
         case PREFETCH:
         case PREFETCH_STOP:
-        case NEXT:  if(itr->Valid()) itr->Next(); break;
+        case NEXT:
+            if (!m_ItrWrap->TakePositioned(itr, false) && itr->Valid())
+                itr->Next();
+            m_ItrWrap->m_Reverse=false;
+            break;
 
-        case PREV:  if(itr->Valid()) itr->Prev(); break;
+        case PREV:
+            if (!m_ItrWrap->TakePositioned(itr, true) && itr->Valid())
+                itr->Prev();
+            m_ItrWrap->m_Reverse=true;
+            break;
 
         case SEEK:
         {
             leveldb::Slice key_slice(seek_target);
 
             itr->Seek(key_slice);
+            m_ItrWrap->m_Reverse=false;
             break;
         }   // case
 
@@ -272,6 +528,8 @@ MoveTask::DoWork()
 
     }   // switch
 
+    m_ItrWrap->CountMove(itr);
+
     // set state for Erlang side to read
     m_ItrWrap->SetValid(itr->Valid());
 
@@ -334,11 +592,294 @@ MoveTask::DoWork()
 }
 
 
+/**
+ * Move forward up to packed_count entries and return all of them in
+ *  one binary of length prefixed frames:
+ *    <<KeyLen:32/big, Key/binary, ValueLen:32/big, Value/binary>>
+ *  Value half of frame is omitted for keys_only iterators.
+ *  Always replies by message (async_iterator_move set m_HandoffAtomic).
+ */
+work_result
+MoveTask::PackEntries(
+    leveldb::Iterator * itr)
+{
+    // soft limit, a frame that starts below it is always completed
+    static const size_t packed_byte_limit=4*1024*1024;
+
+    ErlNifBinary bin;
+    size_t used, count, need;
+
+    used=0;
+    count=0;
+
+    if (!enif_alloc_binary(64*1024, &bin))
+        return work_result(local_env(), ATOM_ERROR, ATOM_BADARG);
+
+    m_ItrWrap->m_Reverse=false;
+
+    while (count<packed_count && used<packed_byte_limit
+           && (itr->Valid() || m_ItrWrap->m_Positioned))
+    {
+        if (!m_ItrWrap->TakePositioned(itr, false))
+            itr->Next();
+        m_ItrWrap->CountMove(itr);
+
+        if (!itr->Valid())
+            break;
+
+        leveldb::Slice key(itr->key());
+        leveldb::Slice value(m_ItrWrap->m_KeysOnly ? leveldb::Slice() : itr->value());
+
+        need=used + 4 + key.size() + (m_ItrWrap->m_KeysOnly ? 0 : 4 + value.size());
+        if (bin.size < need)
+        {
+            size_t new_size(bin.size*2);
+
+            if (new_size < need)
+                new_size=need;
+
+            if (!enif_realloc_binary(&bin, new_size))
+            {
+                enif_release_binary(&bin);
+                return work_result(local_env(), ATOM_ERROR, ATOM_BADARG);
+            }   // if
+        }   // if
+
+        used=pack_frame(bin.data, used, key);
+        if (!m_ItrWrap->m_KeysOnly)
+            used=pack_frame(bin.data, used, value);
+        ++count;
+    }   // while
+
+    m_ItrWrap->SetValid(itr->Valid());
+
+    if (m_ItrWrap->m_Options.iterator_refresh)
+    {
+        if (itr->Valid())
+        {
+            m_ItrWrap->m_RecentKey.assign(itr->key().data(), itr->key().size());
+        }   // if
+        else
+        {
+            // release iterator now, not later
+            m_ItrWrap->m_StillUse=false;
+            m_ItrWrap->PurgeIterator();
+        }   // else
+    }   // if
+
+    // setup for next move, same as end of DoWork
+    m_ItrWrap->m_HandoffAtomic=0;
+
+    if (0==count)
+    {
+        enif_release_binary(&bin);
+        return work_result(local_env(), ATOM_ERROR, ATOM_INVALID_ITERATOR);
+    }   // if
+
+    enif_realloc_binary(&bin, used);
+
+    return work_result(local_env(), ATOM_PACKED, enif_make_binary(local_env(), &bin));
+
+}   // MoveTask::PackEntries
+
+
+/**
+ * Build continuation token for last entry Erlang received:
+ *    <<Version:8, Direction:8, Key/binary>>
+ *  Version is 1, Direction 0 forward / 1 reverse.  Valid after
+ *  next/prev/seek style moves or prefetch_stop, same as other
+ *  non-prefetch actions.
+ */
+work_result
+MoveTask::MakeContinuation(
+    leveldb::Iterator * itr)
+{
+    leveldb::Slice key;
+    bool reverse;
+
+    // setup for next move, same as end of DoWork
+    m_ItrWrap->m_HandoffAtomic=0;
+
+    if (m_ItrWrap->m_Resume)
+    {
+        // no move since iterator_resume, hand back same position
+        key=m_ItrWrap->m_ResumeKey;
+        reverse=m_ItrWrap->m_ResumeReverse;
+    }   // if
+    else if (m_ItrWrap->m_Reposition)
+    {
+        // prefetch ring read ahead of Erlang
+        key=m_ItrWrap->m_RepositionKey;
+        reverse=false;
+    }   // else if
+    else if (itr->Valid() && !m_ItrWrap->m_Positioned)
+    {
+        key=itr->key();
+        reverse=m_ItrWrap->m_Reverse;
+    }   // else if
+    else
+    {
+        return work_result(local_env(), ATOM_ERROR, ATOM_INVALID_ITERATOR);
+    }   // else
+
+    ERL_NIF_TERM token;
+    unsigned char * buffer;
+
+    buffer=enif_make_new_binary(local_env(), 2 + key.size(), &token);
+    buffer[0]=1;
+    buffer[1]=(reverse ? 1 : 0);
+    memcpy(buffer+2, key.data(), key.size());
+
+    return work_result(local_env(), ATOM_CONTINUATION, token);
+
+}   // MoveTask::MakeContinuation
+
+
+/**
+ * Read ahead into prefetch ring until it is full, keys end, or
+ *  Erlang sends prefetch_stop.  Caller (async_iterator_move) claimed
+ *  m_RingWorker for this task.  See async_iterator_move for the
+ *  Erlang side of the m_RingWaiting handshake.
+ */
+work_result
+MoveTask::FillRing(
+    leveldb::Iterator * itr)
+{
+    bool again;
+    uint32_t waiting;
+
+    do
+    {
+        again=false;
+
+        while (!m_ItrWrap->RingFinished() && !m_ItrWrap->m_Ring.IsFull()
+               && 0==leveldb::add_and_fetch(&m_ItrWrap->m_RingStop, (uint32_t)0))
+        {
+            RingStep(itr);
+
+            // Erlang found ring empty and awaits a message
+            if (!m_ItrWrap->m_Ring.IsEmpty()
+                && leveldb::compare_and_swap(&m_ItrWrap->m_RingWaiting, 1, 0))
+                SendRingReply(false);
+        }   // while
+
+        // release ownership BEFORE looking at m_RingWaiting, Erlang
+        //  sets m_RingWaiting BEFORE looking at m_RingWorker
+        m_ItrWrap->RingRelease();
+        waiting=leveldb::add_and_fetch(&m_ItrWrap->m_RingWaiting, (uint32_t)0);
+
+        if (2==waiting)
+        {
+            if (leveldb::compare_and_swap(&m_ItrWrap->m_RingWaiting, 2, 0))
+            {
+                // prefetch_stop still returns "next" when nothing is read ahead
+                if (m_ItrWrap->m_Ring.IsEmpty() && !m_ItrWrap->RingFinished())
+                    RingStep(itr);
+
+                SendRingReply(true);
+            }   // if
+        }   // if
+
+        else if (1==waiting)
+        {
+            if (!m_ItrWrap->m_Ring.IsEmpty() || m_ItrWrap->RingFinished())
+            {
+                if (leveldb::compare_and_swap(&m_ItrWrap->m_RingWaiting, 1, 0))
+                    SendRingReply(false);
+            }   // if
+
+            // Erlang drained ring while this loop was stopping,
+            //  continue unless a newer MoveTask already took over
+            else
+            {
+                again=m_ItrWrap->RingClaim();
+            }   // else
+        }   // else if
+    } while(again);
+
+    return(work_result());
+
+}   // MoveTask::FillRing
+
+
+/**
+ * Advance iterator one position and publish the result to
+ *  the prefetch ring, or mark ring finished at end of keys
+ */
+void
+MoveTask::RingStep(
+    leveldb::Iterator * itr)
+{
+    if (NULL!=itr && (itr->Valid() || m_ItrWrap->m_Positioned))
+    {
+        if (!m_ItrWrap->TakePositioned(itr, false))
+            itr->Next();
+        m_ItrWrap->CountMove(itr);
+    }   // if
+
+    if (NULL!=itr && itr->Valid())
+    {
+        PrefetchRing::Entry & entry(m_ItrWrap->m_Ring.Back());
+
+        entry.m_Key.assign(itr->key().data(), itr->key().size());
+        if (!m_ItrWrap->m_KeysOnly)
+            entry.m_Value.assign(itr->value().data(), itr->value().size());
+
+        if (m_ItrWrap->m_Options.iterator_refresh)
+            m_ItrWrap->m_RecentKey=entry.m_Key;
+
+        m_ItrWrap->m_Ring.Push();
+    }   // if
+    else
+    {
+        // release iterator now, not later
+        if (NULL!=itr && m_ItrWrap->m_Options.iterator_refresh)
+        {
+            m_ItrWrap->m_StillUse=false;
+            m_ItrWrap->PurgeIterator();
+        }   // if
+
+        leveldb::compare_and_swap(&m_ItrWrap->m_RingEnd, 0, 1);
+    }   // else
+
+    return;
+
+}   // MoveTask::RingStep
+
+
+/**
+ * Send front of prefetch ring to waiting Erlang process.
+ *  Might be called more than once per task.
+ */
+void
+MoveTask::SendRingReply(
+    bool Stop)
+{
+    ErlNifPid pid;
+    ERL_NIF_TERM reply;
+
+    reply=m_ItrWrap->RingReply(local_env(), Stop);
+
+    if(0 != enif_get_local_pid(local_env(), this->pid(), &pid))
+    {
+        ERL_NIF_TERM result_tuple = enif_make_tuple2(local_env(), caller_ref(), reply);
+
+        enif_send(0, &pid, local_env(), result_tuple);
+    }   // if
+
+    // enif_send cleared local_env, recreate terms on next use
+    terms_set=false;
+
+    return;
+
+}   // MoveTask::SendRingReply
+
+
 ErlNifEnv *
 MoveTask::local_env()
 {
     if (NULL==local_env_)
-        local_env_ = enif_alloc_env();
+        local_env_ = EnvPool::Alloc();
 
     if (!terms_set)
     {
@@ -352,6 +893,22 @@ MoveTask::local_env()
 }   // MoveTask::local_env
 
 
+/**
+ * Read ahead and whole scans are bulk work, a single move
+ *  that Erlang waits on is interactive.
+ */
+TaskPriority
+MoveTask::Priority()
+{
+    if (PREFETCH==action || PREFETCH_STOP==action || PACKED==action
+        || m_ItrWrap->m_Sequential || m_ItrWrap->m_NoSnapshot)
+        return(ePriorityBulk);
+
+    return(ePriorityInteractive);
+
+}   // MoveTask::Priority
+
+
 void
 MoveTask::recycle()
 {
@@ -374,6 +931,85 @@ MoveTask::recycle()
 
 }   // MoveTask::recycle
 
+
+/**
+ * A dropped move leaves the iterator where it was.  Clear the
+ *  handoff so the next prefetch does not expect a waiting result.
+ */
+work_result
+MoveTask::DropWork(
+    ERL_NIF_TERM Reason)
+{
+    m_ItrWrap->m_HandoffAtomic=0;
+
+    return(WorkTask::DropWork(Reason));
+
+}   // MoveTask::DropWork
+
+
+/**
+ * Execute queued moves until the queue is empty.  Each one behaves
+ *  exactly like the same action given to async_iterator_move, and
+ *  its reply goes to the process that queued it.
+ */
+work_result
+QueueMoveTask::DoWork()
+{
+    QueuedMove move;
+    bool more(m_ItrWrap->QueuePop(move));
+
+    while (more)
+    {
+        unsigned long id(move.m_Id);
+
+        action=(action_t)move.m_Action;
+        packed_count=move.m_Count;
+        seek_target.swap(move.m_Target);
+        local_pid=move.m_Pid;
+        terms_set=false;
+
+        // force MoveTask::DoWork to return its reply
+        m_ItrWrap->m_HandoffAtomic=1;
+        m_ItrWrap->m_PrefetchStarted=false;
+
+        work_result result(MoveTask::DoWork());
+
+        // release consumer side before the last reply goes out,
+        //  its receiver may call iterator_move at once
+        more=m_ItrWrap->QueuePop(move);
+
+        if (result.is_set())
+            SendQueueReply(id, result.result());
+    }   // while
+
+    return(work_result());
+
+}   // QueueMoveTask::DoWork
+
+
+void
+QueueMoveTask::SendQueueReply(
+    unsigned long Id,
+    ERL_NIF_TERM Reply)
+{
+    ErlNifPid pid;
+
+    if(0 != enif_get_local_pid(local_env(), this->pid(), &pid))
+    {
+        ERL_NIF_TERM result_tuple = enif_make_tuple3(local_env(), caller_ref(),
+                                                     enif_make_ulong(local_env(), Id),
+                                                     Reply);
+
+        enif_send(0, &pid, local_env(), result_tuple);
+    }   // if
+
+    // enif_send cleared local_env, recreate terms on next use
+    terms_set=false;
+
+    return;
+
+}   // QueueMoveTask::SendQueueReply
+
 /**
  * DestroyTask functions
  */
@@ -402,6 +1038,420 @@ DestroyTask::DoWork()
 }   // DestroyTask::DoWork()
 
 
-} // namespace eleveldb
+/**
+ * StatusTask functions
+ */
+
+StatusTask::StatusTask(
+    ErlNifEnv* caller_env,
+    ERL_NIF_TERM& _caller_ref,
+    DbObject * _db_handle,
+    ERL_NIF_TERM NameTerm)
+    : WorkTask(caller_env, _caller_ref, _db_handle),
+    m_Multi(false)
+{
+    ErlNifBinary name_bin;
+
+    if (enif_inspect_binary(caller_env, NameTerm, &name_bin))
+    {
+        m_Names.push_back(std::string((const char *)name_bin.data, name_bin.size));
+    }   // if
+    else
+    {
+        ERL_NIF_TERM head, tail;
+
+        m_Multi=true;
+        tail=NameTerm;
+        while (enif_get_list_cell(caller_env, tail, &head, &tail)
+               && enif_inspect_binary(caller_env, head, &name_bin))
+            m_Names.push_back(std::string((const char *)name_bin.data, name_bin.size));
+    }   // else
+
+}   // StatusTask::StatusTask
+
+
+/**
+ * {ok, Value} or error, same as the synchronous status call
+ */
+ERL_NIF_TERM
+StatusTask::PropertyResult(
+    const std::string & Name)
+{
+    ERL_NIF_TERM result;
+    std::string value;
+
+    if (m_DbPtr->GetProperty(Name, &value))
+    {
+        ERL_NIF_TERM value_bin;
+        unsigned char * buf;
+
+        buf=enif_make_new_binary(local_env(), value.size(), &value_bin);
+        memcpy(buf, value.data(), value.size());
+        result=enif_make_tuple2(local_env(), ATOM_OK, value_bin);
+    }   // if
+    else
+    {
+        result=ATOM_ERROR;
+    }   // else
+
+    return(result);
+
+}   // StatusTask::PropertyResult
 
 
+work_result
+StatusTask::DoWork()
+{
+    if (NULL==m_DbPtr->m_Db)
+        return work_result(local_env(), ATOM_ERROR, ATOM_EINVAL);
+
+    if (!m_Multi)
+        return work_result(PropertyResult(m_Names.front()));
+
+    // build list back to front so it keeps the caller's order
+    ERL_NIF_TERM list, name_bin;
+    std::vector<std::string>::reverse_iterator it;
+    unsigned char * buf;
+
+    list=enif_make_list(local_env(), 0);
+    for (it=m_Names.rbegin(); m_Names.rend()!=it; ++it)
+    {
+        buf=enif_make_new_binary(local_env(), it->size(), &name_bin);
+        memcpy(buf, it->data(), it->size());
+        list=enif_make_list_cell(local_env(),
+                                 enif_make_tuple2(local_env(), name_bin, PropertyResult(*it)),
+                                 list);
+    }   // for
+
+    return work_result(list);
+
+}   // StatusTask::DoWork
+
+
+/**
+ * RepairTask functions
+ */
+
+/**
+ * leveldb::RepairDB() has no progress callback, but writes one
+ *  info log line per log file converted and table scanned.  This
+ *  logger counts those lines and passes them on to the database's
+ *  LOG file.
+ */
+class RepairLogger : public leveldb::Logger
+{
+protected:
+    RepairTask * m_Task;
+    leveldb::Logger * m_Log;          //!< LOG file, or NULL
+
+public:
+    RepairLogger(RepairTask * Task, leveldb::Logger * Log)
+        : m_Task(Task), m_Log(Log) {};
+
+    virtual ~RepairLogger() {delete m_Log;};
+
+    virtual void Logv(const char * Format, va_list Ap)
+    {
+        char line[512];
+
+        vsnprintf(line, sizeof(line), Format, Ap);
+        m_Task->LogLine(line);
+
+        if (NULL!=m_Log)
+            leveldb::Log(m_Log, "%s", line);
+    };
+
+private:
+    RepairLogger();
+    RepairLogger(const RepairLogger &);
+    RepairLogger & operator=(const RepairLogger &);
+};  // class RepairLogger
+
+
+RepairTask::RepairTask(
+    ErlNifEnv* caller_env,
+    ERL_NIF_TERM& _caller_ref,
+    const std::string& db_name_,
+    const leveldb::Options & options_)
+    : WorkTask(caller_env, _caller_ref),
+    db_name(db_name_), options(options_),
+    m_Logs(0), m_Tables(0), m_Entries(0), m_Bytes(0), m_LastProgress(0)
+{
+}   // RepairTask::RepairTask
+
+
+/**
+ * Line formats are those of leveldb's db/repair.cc, lines that
+ *  do not match are only logged.
+ */
+void
+RepairTask::LogLine(
+    const char * Line)
+{
+    unsigned long long number, bytes;
+    int count, files;
+    const char * recovered;
+
+    if (2==sscanf(Line, "Table #%llu: %d entries", &number, &count))
+    {
+        ++m_Tables;
+        m_Entries+=(0<count ? count : 0);
+        Progress(false);
+    }   // if
+    else if (2==sscanf(Line, "Log #%llu: %d ops saved", &number, &count))
+    {
+        ++m_Logs;
+        m_Entries+=(0<count ? count : 0);
+        Progress(false);
+    }   // else if
+    else if (NULL!=(recovered=strstr(Line, "recovered "))
+             && 2==sscanf(recovered, "recovered %d files; %llu bytes", &files, &bytes))
+    {
+        m_Bytes=bytes;
+    }   // else if
+
+}   // RepairTask::LogLine
+
+
+/**
+ * Progress goes out in its own environment, enif_send() would
+ *  clear local_env() and with it the caller ref of the final reply.
+ */
+void
+RepairTask::Progress(
+    bool Force)
+{
+    uint64_t now(TaskPool::NowMicros());
+    ErlNifPid caller_pid;
+
+    if ((Force || m_LastProgress + 1000000 <= now)
+        && 0 != enif_get_local_pid(local_env(), pid(), &caller_pid))
+    {
+        ErlNifEnv * msg_env(EnvPool::Alloc());
+        ERL_NIF_TERM counters[4], msg;
+
+        counters[0]=enif_make_tuple2(msg_env, ATOM_LOGS, enif_make_uint64(msg_env, m_Logs));
+        counters[1]=enif_make_tuple2(msg_env, ATOM_TABLES, enif_make_uint64(msg_env, m_Tables));
+        counters[2]=enif_make_tuple2(msg_env, ATOM_ENTRIES, enif_make_uint64(msg_env, m_Entries));
+        counters[3]=enif_make_tuple2(msg_env, ATOM_BYTES, enif_make_uint64(msg_env, m_Bytes));
+
+        msg=enif_make_tuple2(msg_env, enif_make_copy(msg_env, caller_ref()),
+                             enif_make_tuple2(msg_env, ATOM_REPAIR_PROGRESS,
+                                              enif_make_list_from_array(msg_env, counters, 4)));
+        enif_send(0, &caller_pid, msg_env, msg);
+        EnvPool::Free(msg_env);
+        m_LastProgress=now;
+    }   // if
+
+}   // RepairTask::Progress
+
+
+work_result
+RepairTask::DoWork()
+{
+    leveldb::Env * env(NULL!=options.env ? options.env : leveldb::Env::Default());
+    leveldb::Logger * log(NULL);
+
+    // same LOG / LOG.old rotation RepairDB() does without an info_log
+    if (NULL==options.info_log)
+    {
+        env->RenameFile(db_name + "/LOG", db_name + "/LOG.old");
+        if (!env->NewLogger(db_name + "/LOG", &log).ok())
+            log=NULL;
+    }   // if
+
+    RepairLogger logger(this, log);
+    options.info_log=&logger;
+
+    leveldb::Status status = leveldb::RepairDB(db_name, options);
+    options.info_log=NULL;
+
+    Progress(true);
+
+    if(!status.ok())
+        return error_tuple(local_env(), ATOM_ERROR_DB_REPAIR, status);
+
+    return work_result(ATOM_OK);
+
+}   // RepairTask::DoWork
+
+
+/**
+ * MergeIterTask functions
+ */
+
+work_result
+MergeIterTask::DoWork()
+{
+    void * merge_ptr_ptr;
+    MergeItrObject * merge_ptr;
+    std::vector<DbObject *>::iterator it;
+
+    merge_ptr_ptr=MergeItrObject::CreateMergeItrObject(keys_only);
+    merge_ptr=*(MergeItrObject **)merge_ptr_ptr;
+
+    // each source keeps the reference from its enif_alloc_resource
+    for (it=m_Dbs.begin(); m_Dbs.end()!=it; ++it)
+        merge_ptr->m_Sources.push_back(
+            IterTask::CreateIterator(*it, keys_only, options, itr_options,
+                                     caller_ref(), pid()));
+
+    ERL_NIF_TERM result = enif_make_resource(local_env(), merge_ptr_ptr);
+
+    // release reference created during CreateMergeItrObject()
+    enif_release_resource(merge_ptr_ptr);
+
+    return work_result(local_env(), ATOM_OK, result);
+
+}   // MergeIterTask::DoWork
+
+
+
+/**
+ * MergeMoveTask functions
+ */
+
+// heap ordering for std::make_heap & co: true if source A sorts
+//  after source B, so smallest key is at front.  Ties go to lower
+//  source index.
+struct MergeCompare
+{
+    std::vector<LevelIteratorWrapper *> & m_Wraps;
+    const leveldb::Comparator * m_Comparator;
+
+    MergeCompare(std::vector<LevelIteratorWrapper *> & Wraps, const leveldb::Comparator * Comparator)
+        : m_Wraps(Wraps), m_Comparator(Comparator) {};
+
+    bool operator()(size_t A, size_t B) const
+    {
+        int ret_val;
+
+        ret_val=m_Comparator->Compare(m_Wraps[A]->get()->key(), m_Wraps[B]->get()->key());
+
+        return(0<ret_val || (0==ret_val && B<A));
+    }
+};  // struct MergeCompare
+
+
+work_result
+MergeMoveTask::DoWork()
+{
+    MergeItrObject * merge_ptr;
+    std::vector<LevelIteratorWrapper *> wraps;
+    std::vector<ERL_NIF_TERM> entries;
+    ERL_NIF_TERM ret_term;
+    bool closed;
+    size_t loop;
+
+    merge_ptr=m_MergePtr.get();
+
+    leveldb::MutexLock lock(&merge_ptr->m_MergeMutex);
+
+    if (CLOSE==action)
+    {
+        merge_ptr->CloseSources();
+        return(work_result(ATOM_OK));
+    }   // if
+
+    // hold each source's wrapper for the duration of this move,
+    //  any source closed by its database closes the merge
+    closed=merge_ptr->m_Sources.empty();
+    for (loop=0; loop<merge_ptr->m_Sources.size() && !closed; ++loop)
+    {
+        ReferencePtr<ItrObject> itr_ptr;
+        LevelIteratorWrapper * wrap_ptr(NULL);
+
+        itr_ptr.assign(*(ItrObject * volatile *)merge_ptr->m_Sources[loop]);
+
+        if (NULL!=itr_ptr.get() && 0==itr_ptr->GetCloseRequested())
+            wrap_ptr=itr_ptr->m_Iter.get();
+
+        if (NULL!=wrap_ptr && NULL!=wrap_ptr->get())
+        {
+            wrap_ptr->RefInc();
+            wraps.push_back(wrap_ptr);
+        }   // if
+        else
+        {
+            closed=true;
+        }   // else
+    }   // for
+
+    if (closed)
+    {
+        ret_term=enif_make_tuple2(local_env(), ATOM_ERROR, ATOM_ITERATOR_CLOSED);
+    }   // if
+    else
+    {
+        std::vector<size_t> & heap(merge_ptr->m_Heap);
+        const leveldb::Comparator * comparator(wraps[0]->m_DbPtr->m_DbOptions->comparator);
+        MergeCompare compare(wraps, comparator);
+
+        if (FIRST==action || SEEK==action)
+        {
+            leveldb::Slice key_slice(seek_target);
+
+            heap.clear();
+            for (loop=0; loop<wraps.size(); ++loop)
+            {
+                leveldb::Iterator * itr(wraps[loop]->get());
+
+                if (FIRST==action)
+                    itr->SeekToFirst();
+                else
+                    itr->Seek(key_slice);
+
+                if (itr->Valid())
+                    heap.push_back(loop);
+            }   // for
+
+            std::make_heap(heap.begin(), heap.end(), compare);
+        }   // if
+
+        // every iterator in heap sits on its next unreturned entry
+        while (entries.size()<batch && !heap.empty())
+        {
+            leveldb::Iterator * itr;
+            ERL_NIF_TERM index;
+            size_t source;
+
+            std::pop_heap(heap.begin(), heap.end(), compare);
+            source=heap.back();
+            itr=wraps[source]->get();
+
+            // Erlang side index is 1 based, position in list of databases
+            index=enif_make_ulong(local_env(), source+1);
+            if (merge_ptr->m_KeysOnly)
+                entries.push_back(enif_make_tuple2(local_env(), index,
+                                                   slice_to_binary(local_env(), itr->key())));
+            else
+                entries.push_back(enif_make_tuple3(local_env(), index,
+                                                   slice_to_binary(local_env(), itr->key()),
+                                                   slice_to_binary(local_env(), itr->value())));
+
+            itr->Next();
+            wraps[source]->CountMove(itr);
+
+            if (itr->Valid())
+                std::push_heap(heap.begin(), heap.end(), compare);
+            else
+                heap.pop_back();
+        }   // while
+
+        if (entries.empty())
+            ret_term=enif_make_tuple2(local_env(), ATOM_ERROR, ATOM_INVALID_ITERATOR);
+        else
+            ret_term=enif_make_tuple2(local_env(), ATOM_OK,
+                                      enif_make_list_from_array(local_env(), &entries[0],
+                                                                entries.size()));
+    }   // else
+
+    for (loop=0; loop<wraps.size(); ++loop)
+        wraps[loop]->RefDec();
+
+    return(work_result(ret_term));
+
+}   // MergeMoveTask::DoWork
+
+
+} // namespace eleveldb
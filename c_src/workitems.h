@@ -44,6 +44,14 @@
     #include "refobjects.h"
 #endif
 
+#ifndef INCL_TASKPOOL_H
+    #include "taskpool.h"
+#endif
+
+#ifndef INCL_FREELIST_H
+    #include "freelist.h"
+#endif
+
 namespace eleveldb {
 
 /* Type returned from a work task: */
@@ -66,6 +74,16 @@ class WorkTask : public leveldb::ThreadTask
 
     ErlNifPid local_pid;   // maintain for task lifetime (JFW)
 
+    // maintained by TaskPool::Submit
+    TaskClassStats * m_ClassStats;              //!< counters of this task's priority class
+    TaskLatency    * m_Latency;                 //!< histograms of this task's type
+    uint64_t       m_SubmitMicros;              //!< submit time, 0 once started
+    bool           m_Borrowed;                  //!< running on another class's thread
+    ShardSet       * m_ShardSet;                //!< set counting this task in flight, or NULL
+
+    uint64_t       m_DeadlineMicros;            //!< TaskPool::NowMicros() to drop task by, 0 none
+    ReferencePtr<CancelObject> m_Cancel;        //!< {cancel, Token} of this task, or NULL
+
  public:
     WorkTask(ErlNifEnv *caller_env, ERL_NIF_TERM& caller_ref);
 
@@ -73,6 +91,10 @@ class WorkTask : public leveldb::ThreadTask
 
     virtual ~WorkTask();
 
+    // task objects and their environments are recycled, see freelist.h
+    static void * operator new(size_t Size) {return(TaskMemory::Alloc(Size));};
+    static void operator delete(void * Ptr, size_t Size) {TaskMemory::Free(Ptr, Size);};
+
     // this is the method called from the thread pool's worker thread; it
     // calls DoWork(), implemented in the subclass, and returns the result
     // of the work to the caller
@@ -84,10 +106,39 @@ class WorkTask : public leveldb::ThreadTask
     const ERL_NIF_TERM& caller_ref()       { local_env(); return caller_ref_term; }
     const ERL_NIF_TERM& pid()              { local_env(); return caller_pid_term; }
 
+    // database this task works on, NULL for iterator and global tasks
+    DbObject * GetDbObject()               { return m_DbPtr.get(); }
+
+    // scheduling class, see TaskPool
+    virtual TaskPriority Priority()        { return ePriorityInteractive; }
+
+    // latency histogram selection, see TaskPool::Latency()
+    virtual TaskType Type()                { return eTaskOther; }
+
+    void SetSubmitted(TaskClassStats * Stats, TaskLatency * Latency, uint64_t Micros)
+        { m_ClassStats=Stats; m_Latency=Latency; m_SubmitMicros=Micros; }
+
+    void SetBorrowed(bool Flag);
+
+    // called by TaskPool::SubmitShards, keeps a retired ShardSet alive while task runs
+    void SetShardSet(ShardSet * Set);
+
+    // {deadline, Ms} and {cancel, Token} options, checked before DoWork()
+    void SetLimits(uint64_t DeadlineMicros, CancelObject * Cancel)
+        { m_DeadlineMicros=DeadlineMicros; m_Cancel.assign(Cancel); }
+
+    // execute on caller's thread, reply is the return value (dirty I/O scheduler)
+    work_result RunDirect();
+
  protected:
     // this is the method that does the real work for this task
     virtual work_result DoWork() = 0;
 
+    // reply {error, timeout | cancelled} instead of running DoWork(), 0 if task should run
+    ERL_NIF_TERM DropReason();
+
+    virtual work_result DropWork(ERL_NIF_TERM Reason);
+
  private:
     WorkTask();
     WorkTask(const WorkTask &);
@@ -105,13 +156,20 @@ class OpenTask : public WorkTask
 protected:
     std::string         db_name;
     leveldb::Options   *open_options;  // associated with db handle, we don't free it
+    bool                dirty_io;      // copied to DbObject::m_DirtyIO
+    MemoryGovernor     *governor;      // new database registers here, or NULL
 
 public:
     OpenTask(ErlNifEnv* caller_env, ERL_NIF_TERM& _caller_ref,
-             const std::string& db_name_, leveldb::Options *open_options_);
+             const std::string& db_name_, leveldb::Options *open_options_,
+             bool dirty_io_=false, MemoryGovernor * governor_=NULL);
 
     virtual ~OpenTask() {};
 
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
+    virtual TaskType Type() {return(eTaskOpen);};
+
 protected:
     virtual work_result DoWork();
 
@@ -133,16 +191,19 @@ class WriteTask : public WorkTask
 protected:
     leveldb::WriteBatch*    batch;
     leveldb::WriteOptions*          options;
+    uint64_t                m_Bytes;        //!< key and value bytes, summed while batch was parsed
 
 public:
 
     WriteTask(ErlNifEnv* _owner_env, ERL_NIF_TERM _caller_ref,
                 DbObject * _db_handle,
                 leveldb::WriteBatch* _batch,
-                leveldb::WriteOptions* _options)
+                leveldb::WriteOptions* _options,
+                uint64_t _bytes)
         : WorkTask(_owner_env, _caller_ref, _db_handle),
        batch(_batch),
-       options(_options)
+       options(_options),
+       m_Bytes(_bytes)
     {}
 
     virtual ~WriteTask()
@@ -151,11 +212,16 @@ public:
         delete options;
     }
 
+    virtual TaskType Type() {return(eTaskWrite);};
+
 protected:
     virtual work_result DoWork()
     {
         leveldb::Status status = m_DbPtr->m_Db->Write(*options, batch);
 
+        m_DbPtr->m_Counters.Add(eDbWrites);
+        m_DbPtr->m_Counters.Add(eDbBytesIn, m_Bytes);
+
         return (status.ok() ? work_result(ATOM_OK) : work_result(local_env(), ATOM_ERROR_DB_WRITE, status));
     }
 
@@ -171,6 +237,7 @@ class BinaryValue : public leveldb::Value
 private:
     ErlNifEnv* m_env;
     ERL_NIF_TERM& m_value_bin;
+    size_t m_size;
 
     BinaryValue(const BinaryValue&);
     void operator=(const BinaryValue&);
@@ -178,7 +245,7 @@ private:
 public:
 
     BinaryValue(ErlNifEnv* env, ERL_NIF_TERM& value_bin)
-    : m_env(env), m_value_bin(value_bin)
+    : m_env(env), m_value_bin(value_bin), m_size(0)
     {};
 
     virtual ~BinaryValue() {};
@@ -187,9 +254,12 @@ public:
     {
         unsigned char* v = enif_make_new_binary(m_env, size, &m_value_bin);
         memcpy(v, data, size);
+        m_size=size;
         return *this;
     };
 
+    size_t size() const {return(m_size);};
+
 };
 
 
@@ -223,6 +293,8 @@ public:
     {
     }
 
+    virtual TaskType Type() {return(eTaskGet);};
+
 protected:
     virtual work_result DoWork()
     {
@@ -232,8 +304,16 @@ protected:
 
         leveldb::Status status = m_DbPtr->m_Db->Get(options, key_slice, &value);
 
+        m_DbPtr->m_Counters.Add(eDbGets);
+
         if(!status.ok())
+        {
+            m_DbPtr->m_Counters.Add(eDbMisses);
             return work_result(ATOM_NOT_FOUND);
+        }   // if
+
+        m_DbPtr->m_Counters.Add(eDbHits);
+        m_DbPtr->m_Counters.Add(eDbBytesOut, value.size());
 
         return work_result(local_env(), ATOM_OK, value_bin);
     }
@@ -252,37 +332,37 @@ protected:
 
     const bool keys_only;
     leveldb::ReadOptions options;
+    IteratorOptions itr_options;
 
 public:
     IterTask(ErlNifEnv *_caller_env,
              ERL_NIF_TERM _caller_ref,
              DbObject *_db_handle,
              const bool _keys_only,
-             leveldb::ReadOptions &_options)
+             leveldb::ReadOptions &_options,
+             IteratorOptions &_itr_options)
         : WorkTask(_caller_env, _caller_ref, _db_handle),
-        keys_only(_keys_only), options(_options)
+        keys_only(_keys_only), options(_options), itr_options(_itr_options)
     {}
 
     virtual ~IterTask()
     {
     }
 
+    // ItrObject resource with a ready LevelIteratorWrapper, caller
+    //  owns the reference from enif_alloc_resource
+    static void * CreateIterator(DbObject * DbPtr, bool KeysOnly,
+                                 leveldb::ReadOptions & Options,
+                                 IteratorOptions & ItrOptions,
+                                 ERL_NIF_TERM CallerRef, ERL_NIF_TERM OwnerPid);
+
 protected:
     virtual work_result DoWork()
     {
-        ItrObject * itr_ptr;
         void * itr_ptr_ptr;
 
-        // NOTE: transfering ownership of options to ItrObject
-        itr_ptr_ptr=ItrObject::CreateItrObject(m_DbPtr.get(), keys_only, options);
-
-        // Copy caller_ref to reuse in future iterator_move calls
-        itr_ptr=*(ItrObject**)itr_ptr_ptr;
-        itr_ptr->itr_ref_env = enif_alloc_env();
-        itr_ptr->itr_ref = enif_make_copy(itr_ptr->itr_ref_env, caller_ref());
-
-        itr_ptr->m_Iter.assign(new LevelIteratorWrapper(itr_ptr, keys_only,
-                                                        options, itr_ptr->itr_ref));
+        itr_ptr_ptr=CreateIterator(m_DbPtr.get(), keys_only, options,
+                                   itr_options, caller_ref(), pid());
 
         ERL_NIF_TERM result = enif_make_resource(local_env(), itr_ptr_ptr);
 
@@ -298,7 +378,7 @@ protected:
 class MoveTask : public WorkTask
 {
 public:
-    typedef enum { FIRST, LAST, NEXT, PREV, SEEK, PREFETCH, PREFETCH_STOP } action_t;
+    typedef enum { FIRST, LAST, NEXT, PREV, SEEK, PREFETCH, PREFETCH_STOP, PACKED, CONTINUATION } action_t;
 
 protected:
     ReferencePtr<LevelIteratorWrapper> m_ItrWrap;             //!< access to database, and holds reference
@@ -306,6 +386,7 @@ protected:
 public:
     action_t                                       action;
     std::string                                 seek_target;
+    size_t                                      packed_count;  //!< PACKED: max entries per reply
 
 public:
 
@@ -313,7 +394,7 @@ public:
     MoveTask(ErlNifEnv *_caller_env, ERL_NIF_TERM _caller_ref,
              LevelIteratorWrapper * IterWrap, action_t& _action)
         : WorkTask(NULL, _caller_ref, IterWrap->m_DbPtr.get()),
-        m_ItrWrap(IterWrap), action(_action)
+        m_ItrWrap(IterWrap), action(_action), packed_count(0)
     {
         // special case construction
         local_env_=NULL;
@@ -326,7 +407,7 @@ public:
              std::string& _seek_target)
         : WorkTask(NULL, _caller_ref, IterWrap->m_DbPtr.get()),
         m_ItrWrap(IterWrap), action(_action),
-        seek_target(_seek_target)
+        seek_target(_seek_target), packed_count(0)
         {
             // special case construction
             local_env_=NULL;
@@ -336,14 +417,60 @@ public:
 
     virtual ErlNifEnv *local_env();
 
+    virtual TaskPriority Priority();
+
+    virtual TaskType Type() {return(eTaskMove);};
+
     virtual void recycle();
 
+protected:
+    virtual work_result DropWork(ERL_NIF_TERM Reason);
+
 protected:
     virtual work_result DoWork();
 
+    // prefetch ring routines
+    work_result FillRing(leveldb::Iterator * itr);
+
+    void RingStep(leveldb::Iterator * itr);
+
+    void SendRingReply(bool Stop);
+
+    // packed frame routine
+    work_result PackEntries(leveldb::Iterator * itr);
+
+    // continuation token routine
+    work_result MakeContinuation(leveldb::Iterator * itr);
+
 };  // class MoveTask
 
 
+/**
+ * Background object that drains an iterator's queue of
+ *  iterator_queue_move requests.  Requests run in order, one
+ *  MoveTask::DoWork() each, and every reply is sent as its own
+ *  {ItrRef, RequestId, Reply} message.  At most one exists per
+ *  iterator, see LevelIteratorWrapper::QueuePush().
+ */
+
+class QueueMoveTask : public MoveTask
+{
+public:
+    QueueMoveTask(ErlNifEnv *_caller_env, ERL_NIF_TERM _caller_ref,
+                  LevelIteratorWrapper * IterWrap, action_t& _action)
+        : MoveTask(_caller_env, _caller_ref, IterWrap, _action)
+    {}
+
+    virtual ~QueueMoveTask() {};
+
+protected:
+    virtual work_result DoWork();
+
+    void SendQueueReply(unsigned long Id, ERL_NIF_TERM Reply);
+
+};  // class QueueMoveTask
+
+
 /**
  * Background object for async databass close
  */
@@ -363,6 +490,10 @@ public:
     {
     }
 
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
+    virtual TaskType Type() {return(eTaskClose);};
+
 protected:
     virtual work_result DoWork()
     {
@@ -412,6 +543,8 @@ public:
     {
     }
 
+    virtual TaskType Type() {return(eTaskClose);};
+
 protected:
     virtual work_result DoWork()
     {
@@ -440,6 +573,92 @@ protected:
 };  // class ItrCloseTask
 
 
+/**
+ * Background object to open one iterator per database
+ *  for a merge iterator
+ */
+
+class MergeIterTask : public WorkTask
+{
+protected:
+    std::vector<DbObject *> m_Dbs;            //!< one reference each, released in destructor
+    const bool keys_only;
+    leveldb::ReadOptions options;
+    IteratorOptions itr_options;
+
+public:
+    MergeIterTask(ErlNifEnv *_caller_env,
+                  ERL_NIF_TERM _caller_ref,
+                  std::vector<DbObject *> & _dbs,
+                  const bool _keys_only,
+                  leveldb::ReadOptions &_options,
+                  IteratorOptions &_itr_options)
+        : WorkTask(_caller_env, _caller_ref),
+        m_Dbs(_dbs), keys_only(_keys_only), options(_options), itr_options(_itr_options)
+    {
+        std::vector<DbObject *>::iterator it;
+
+        for (it=m_Dbs.begin(); m_Dbs.end()!=it; ++it)
+            (*it)->RefInc();
+    }
+
+    virtual ~MergeIterTask()
+    {
+        std::vector<DbObject *>::iterator it;
+
+        for (it=m_Dbs.begin(); m_Dbs.end()!=it; ++it)
+            (*it)->RefDec();
+    }
+
+protected:
+    virtual work_result DoWork();
+
+};  // class MergeIterTask
+
+
+/**
+ * Background object for merge iterator positioning, batch
+ *  retrieval, and close
+ */
+
+class MergeMoveTask : public WorkTask
+{
+public:
+    typedef enum { FIRST, NEXT, SEEK, CLOSE } action_t;
+
+protected:
+    ReferencePtr<MergeItrObject> m_MergePtr;
+
+    action_t action;
+    std::string seek_target;
+    size_t batch;                             //!< max entries in reply
+
+public:
+    MergeMoveTask(ErlNifEnv *_caller_env,
+                  ERL_NIF_TERM _caller_ref,
+                  MergeItrObject * _merge_handle,
+                  action_t _action,
+                  const std::string & _seek_target,
+                  size_t _batch)
+        : WorkTask(_caller_env, _caller_ref),
+        m_MergePtr(_merge_handle), action(_action),
+        seek_target(_seek_target), batch(_batch)
+    {}
+
+    virtual ~MergeMoveTask()
+    {
+    }
+
+    virtual TaskPriority Priority() {return(ePriorityBulk);};
+
+    virtual TaskType Type() {return(eTaskMove);};
+
+protected:
+    virtual work_result DoWork();
+
+};  // class MergeMoveTask
+
+
 /**
  * Background object for async open of a leveldb instance
  */
@@ -456,6 +675,8 @@ public:
 
     virtual ~DestroyTask() {};
 
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
 protected:
     virtual work_result DoWork();
 
@@ -468,6 +689,232 @@ private:
 
 
 
+/**
+ * Background object for async status property queries.  Properties
+ *  like "leveldb.stats" can take milliseconds on large databases.
+ */
+
+class StatusTask : public WorkTask
+{
+protected:
+    std::vector<std::string> m_Names;
+    bool m_Multi;                     //!< list given: reply is a list of {Name, Result}
+
+public:
+    // NameTerm is a binary or a list of binaries, already validated
+    StatusTask(ErlNifEnv* caller_env, ERL_NIF_TERM& _caller_ref,
+               DbObject * _db_handle, ERL_NIF_TERM NameTerm);
+
+    virtual ~StatusTask() {};
+
+    virtual TaskPriority Priority() {return(ePriorityBulk);};
+
+protected:
+    virtual work_result DoWork();
+
+    ERL_NIF_TERM PropertyResult(const std::string & Name);
+
+private:
+    StatusTask();
+    StatusTask(const StatusTask &);
+    StatusTask & operator=(const StatusTask &);
+
+};  // class StatusTask
+
+
+
+/**
+ * Background object for async repair.  leveldb::RepairDB() can run
+ *  for hours, so it goes to the admin class and reports progress
+ *  to the caller as {CallerRef, {repair_progress, Counters}} while
+ *  it runs, see RepairLogger in workitems.cc.
+ */
+
+class RepairTask : public WorkTask
+{
+protected:
+    std::string         db_name;
+    leveldb::Options    options;
+
+    // progress counters, updated only by the thread running DoWork()
+    uint64_t m_Logs;                  //!< log files converted to tables
+    uint64_t m_Tables;                //!< table files scanned
+    uint64_t m_Entries;               //!< entries found in logs and tables
+    uint64_t m_Bytes;                 //!< bytes recovered, set once repair finishes
+    uint64_t m_LastProgress;          //!< NowMicros() of last progress message
+
+public:
+    RepairTask(ErlNifEnv* caller_env, ERL_NIF_TERM& _caller_ref,
+               const std::string& db_name_, const leveldb::Options & options_);
+
+    virtual ~RepairTask() {};
+
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
+    // one leveldb info log line written by RepairDB()
+    void LogLine(const char * Line);
+
+    // send counters to caller, at most once a second unless Force
+    void Progress(bool Force);
+
+protected:
+    virtual work_result DoWork();
+
+private:
+    RepairTask();
+    RepairTask(const RepairTask &);
+    RepairTask & operator=(const RepairTask &);
+
+};  // class RepairTask
+
+
+
+/**
+ * Background object for MemoryGovernor::Rebalance(), submitted
+ *  without a caller so it sends no reply.
+ */
+
+class RebalanceTask : public WorkTask
+{
+protected:
+    MemoryGovernor * m_Governor;
+
+public:
+    RebalanceTask(ErlNifEnv* caller_env, ERL_NIF_TERM& _caller_ref,
+                  MemoryGovernor * Governor)
+        : WorkTask(caller_env, _caller_ref), m_Governor(Governor)
+    {};
+
+    virtual ~RebalanceTask() {};
+
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
+protected:
+    virtual work_result DoWork()
+    {
+        m_Governor->Rebalance();
+        return(work_result());
+    };
+
+private:
+    RebalanceTask();
+    RebalanceTask(const RebalanceTask &);
+    RebalanceTask & operator=(const RebalanceTask &);
+
+};  // class RebalanceTask
+
+
+
+/**
+ * Background object for TaskPool::ReapRetired(), submitted
+ *  without a caller so it sends no reply.
+ */
+
+class ReapTask : public WorkTask
+{
+protected:
+    TaskPool * m_Pool;
+
+public:
+    ReapTask(ErlNifEnv* caller_env, ERL_NIF_TERM& _caller_ref,
+             TaskPool * Pool)
+        : WorkTask(caller_env, _caller_ref), m_Pool(Pool)
+    {};
+
+    virtual ~ReapTask() {};
+
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
+protected:
+    virtual work_result DoWork()
+    {
+        m_Pool->ReapRetired();
+        return(work_result());
+    };
+
+private:
+    ReapTask();
+    ReapTask(const ReapTask &);
+    ReapTask & operator=(const ReapTask &);
+
+};  // class ReapTask
+
+
+
+/**
+ * Background object for shrink_caches, replies {ok, ReclaimedBytes}
+ */
+
+class ShrinkTask : public WorkTask
+{
+protected:
+    MemoryGovernor * m_Governor;
+    uint32_t m_Percent;
+
+public:
+    ShrinkTask(ErlNifEnv* caller_env, ERL_NIF_TERM& _caller_ref,
+               MemoryGovernor * Governor, uint32_t Percent)
+        : WorkTask(caller_env, _caller_ref), m_Governor(Governor), m_Percent(Percent)
+    {};
+
+    virtual ~ShrinkTask() {};
+
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
+protected:
+    virtual work_result DoWork()
+    {
+        uint64_t reclaimed(m_Governor->Shed(m_Percent));
+
+        return(work_result(local_env(), ATOM_OK, enif_make_uint64(local_env(), reclaimed)));
+    };
+
+private:
+    ShrinkTask();
+    ShrinkTask(const ShrinkTask &);
+    ShrinkTask & operator=(const ShrinkTask &);
+
+};  // class ShrinkTask
+
+
+
+/**
+ * Background object for eleveldb:close_idle_iterators/2.  Closing
+ *  an iterator waits for its tasks, so not on a scheduler thread.
+ */
+
+class IdleCloseTask : public WorkTask
+{
+protected:
+    uint32_t m_IdleSeconds;
+
+public:
+    IdleCloseTask(ErlNifEnv* caller_env, ERL_NIF_TERM& _caller_ref,
+                  DbObject * _db_handle, uint32_t IdleSeconds)
+        : WorkTask(caller_env, _caller_ref, _db_handle), m_IdleSeconds(IdleSeconds)
+    {};
+
+    virtual ~IdleCloseTask() {};
+
+    virtual TaskPriority Priority() {return(ePriorityAdmin);};
+
+protected:
+    virtual work_result DoWork()
+    {
+        size_t closed(m_DbPtr->CloseIdleIterators(time(NULL), m_IdleSeconds));
+
+        return(work_result(local_env(), ATOM_OK, enif_make_uint64(local_env(), closed)));
+    };
+
+private:
+    IdleCloseTask();
+    IdleCloseTask(const IdleCloseTask &);
+    IdleCloseTask & operator=(const IdleCloseTask &);
+
+};  // class IdleCloseTask
+
+
+
 } // namespace eleveldb
 
 
@@ -31,8 +31,21 @@
          fold/4,
          fold_keys/4,
          status/2,
+         status_multi/2,
+         pool_status/0,
+         set_threads/1,
+         memory_status/0,
+         shrink_caches/1,
+         task_latency/0,
+         metrics/0,
+         db_stats/1,
+         iterators/1,
+         close_idle_iterators/2,
+         cancel_token/0,
+         cancel/1,
          destroy/2,
          repair/2,
+         repair/3,
          is_empty/1]).
 
 -export([option_types/1,
@@ -40,11 +53,25 @@
 
 -export([iterator/2,
          iterator/3,
+         iterator_resume/3,
+         iterator_resume/4,
          iterator_move/2,
-         iterator_close/1]).
+         iterator_move/3,
+         iterator_queue_move/2,
+         iterator_queue_reply/1,
+         iterator_close/1,
+         unpack_frames/2]).
+
+-export([merge_iterator/2,
+         merge_iterator/3,
+         merge_iterator_move/3,
+         merge_iterator_close/1]).
 
 -export_type([db_ref/0,
-              itr_ref/0]).
+              itr_ref/0,
+              queue_ref/0,
+              cancel_token/0,
+              merge_itr_ref/0]).
 
 -on_load(init/0).
 
@@ -100,7 +127,16 @@ init() ->
                          {is_internal_db, boolean()} |
                          {limited_developer_mem, boolean()} |
                          {eleveldb_threads, pos_integer()} |
+                         {eleveldb_pool_shards, pos_integer()} |
+                         {eleveldb_bulk_threads, non_neg_integer()} |
+                         {eleveldb_admin_threads, non_neg_integer()} |
+                         {eleveldb_cpu_set, string()} |
+                         {eleveldb_numa, boolean()} |
+                         {eleveldb_memory_interval, non_neg_integer()} |
+                         {eleveldb_memory_high_watermark, non_neg_integer()} |
                          {fadvise_willneed, boolean()} |
+                         {iterator_pool_size, non_neg_integer()} |
+                         {iterator_idle_close, non_neg_integer()} |
                          {block_cache_threshold, pos_integer()} |
                          {delete_threshold, pos_integer()} |
                          {tiered_slow_level, pos_integer()} |
@@ -109,30 +145,56 @@ init() ->
                          {cache_object_warming, boolean()} |
                          {expiry_enabled, boolean()} |
                          {expiry_minutes, pos_integer()} |
-                         {whole_file_expiry, boolean()}
+                         {whole_file_expiry, boolean()} |
+                         {dirty_io, boolean()}
                         ].
 
+%% {deadline, erlang:monotonic_time(millisecond) value} and
+%% {cancel, cancel_token()} drop a get, write or move still queued
+%% when the deadline passes or the token is cancelled.  The reply
+%% is then {error, timeout} or {error, cancelled}.
+-type task_limit() :: {deadline, integer()} |
+                      {cancel, cancel_token()}.
+
 -type read_option() :: {verify_checksums, boolean()} |
                        {fill_cache, boolean()} |
-                       {iterator_refresh, boolean()}.
+                       {iterator_refresh, boolean()} |
+                       {iterator_refresh_interval, non_neg_integer()} |
+                       {iterator_refresh_moves, non_neg_integer()} |
+                       {iterator_refresh_bytes, non_neg_integer()} |
+                       {prefetch_depth, pos_integer()} |
+                       {scan_mode, normal | sequential} |
+                       {snapshot, none} |
+                       task_limit().
 
 -type read_options() :: [read_option()].
 
--type fold_option()  :: {first_key, Key::binary()}.
+-type fold_option()  :: {first_key, Key::binary()} |
+                        {fold_packed, pos_integer()}.
 -type fold_options() :: [read_option() | fold_option()].
 
--type write_options() :: [{sync, boolean()}].
+-type write_options() :: [{sync, boolean()} | task_limit()].
 
 -type write_actions() :: [{put, Key::binary(), Value::binary()} |
                           {delete, Key::binary()} |
                           clear].
 
--type iterator_action() :: first | last | next | prev | prefetch | prefetch_stop | binary().
+-type iterator_action() :: first | last | next | prev | prefetch | prefetch_stop |
+                           {packed, pos_integer()} | continuation | binary().
 
 -opaque db_ref() :: binary().
 
 -opaque itr_ref() :: binary().
 
+-opaque merge_itr_ref() :: binary().
+
+-opaque queue_ref() :: {reference(), pos_integer()}.
+
+-opaque cancel_token() :: binary().
+
+-type merge_entry() :: {Source::pos_integer(), Key::binary(), Value::binary()} |
+                       {Source::pos_integer(), Key::binary()}.
+
 -spec async_open(reference(), string(), open_options()) -> ok.
 async_open(_CallerRef, _Name, _Opts) ->
     erlang:nif_error({error, not_loaded}).
@@ -153,15 +215,17 @@ close(Ref) ->
 async_close(_CallerRef, _Ref) ->
     erlang:nif_error({error, not_loaded}).
 
--spec async_get(reference(), db_ref(), binary(), read_options()) -> ok.
+-spec async_get(reference(), db_ref(), binary(), read_options()) -> ok | {reference(), any()}.
 async_get(_CallerRef, _Dbh, _Key, _Opts) ->
     erlang:nif_error({error, not_loaded}).
 
 -spec get(db_ref(), binary(), read_options()) -> {ok, binary()} | not_found | {error, any()}.
 get(Dbh, Key, Opts) ->
     CallerRef = make_ref(),
-    async_get(CallerRef, Dbh, Key, Opts),
-    ?WAIT_FOR_REPLY(CallerRef).
+    case async_get(CallerRef, Dbh, Key, Opts) of
+        {CallerRef, Reply} -> Reply;    %% {dirty_io, true} database
+        _ -> ?WAIT_FOR_REPLY(CallerRef)
+    end.
 
 -spec put(db_ref(), binary(), binary(), write_options()) -> ok | {error, any()}.
 put(Ref, Key, Value, Opts) -> write(Ref, [{put, Key, Value}], Opts).
@@ -172,16 +236,21 @@ delete(Ref, Key, Opts) -> write(Ref, [{delete, Key}], Opts).
 -spec write(db_ref(), write_actions(), write_options()) -> ok | {error, any()}.
 write(Ref, Updates, Opts) ->
     CallerRef = make_ref(),
-    async_write(CallerRef, Ref, Updates, Opts),
-    ?WAIT_FOR_REPLY(CallerRef).
+    case async_write(CallerRef, Ref, Updates, Opts) of
+        {CallerRef, Reply} -> Reply;    %% {dirty_io, true} database
+        _ -> ?WAIT_FOR_REPLY(CallerRef)
+    end.
 
 -spec async_put(db_ref(), reference(), binary(), binary(), write_options()) -> ok.
 async_put(Ref, Context, Key, Value, Opts) ->
     Updates = [{put, Key, Value}],
-    async_write(Context, Ref, Updates, Opts),
+    case async_write(Context, Ref, Updates, Opts) of
+        {Context, _}=Msg -> self() ! Msg;   %% keep the reply a message
+        _ -> ok
+    end,
     ok.
 
--spec async_write(reference(), db_ref(), write_actions(), write_options()) -> ok.
+-spec async_write(reference(), db_ref(), write_actions(), write_options()) -> ok | {reference(), any()}.
 async_write(_CallerRef, _Ref, _Updates, _Opts) ->
     erlang:nif_error({error, not_loaded}).
 
@@ -205,20 +274,52 @@ iterator(Ref, Opts, keys_only) ->
     async_iterator(CallerRef, Ref, Opts, keys_only),
     ?WAIT_FOR_REPLY(CallerRef).
 
+%% Reopen an iterator at a continuation token from
+%% iterator_move(Itr, continuation).  The first next/prefetch returns
+%% the entry after the token's key (prev the one before for a token
+%% taken while moving backward).  The key need not still exist.
+-spec iterator_resume(db_ref(), Token::binary(), read_options()) -> {ok, itr_ref()}.
+iterator_resume(Ref, Token, Opts) when is_binary(Token) ->
+    iterator(Ref, [{resume, Token} | Opts]).
+
+-spec iterator_resume(db_ref(), Token::binary(), read_options(), keys_only) -> {ok, itr_ref()}.
+iterator_resume(Ref, Token, Opts, keys_only) when is_binary(Token) ->
+    iterator(Ref, [{resume, Token} | Opts], keys_only).
+
 -spec async_iterator_move(reference()|undefined, itr_ref(), iterator_action()) -> reference() |
                                                                         {ok, Key::binary(), Value::binary()} |
                                                                         {ok, Key::binary()} |
+                                                                        {packed, Frames::binary()} |
+                                                                        {continuation, Token::binary()} |
                                                                         {error, invalid_iterator} |
                                                                         {error, iterator_closed}.
 async_iterator_move(_CallerRef, _IterRef, _IterAction) ->
     erlang:nif_error({error, not_loaded}).
 
+async_iterator_move(_CallerRef, _IterRef, _IterAction, _Opts) ->
+    erlang:nif_error({error, not_loaded}).
+
 -spec iterator_move(itr_ref(), iterator_action()) -> {ok, Key::binary(), Value::binary()} |
                                                      {ok, Key::binary()} |
+                                                     {packed, Frames::binary()} |
+                                                     {continuation, Token::binary()} |
                                                      {error, invalid_iterator} |
-                                                     {error, iterator_closed}.
-iterator_move(_IRef, _Loc) ->
-    case async_iterator_move(undefined, _IRef, _Loc) of
+                                                     {error, iterator_closed} |
+                                                     {error, busy}.
+iterator_move(IRef, Loc) ->
+    iterator_move(IRef, Loc, []).
+
+%% Opts may hold {deadline, Ms} and {cancel, Token}, see task_limit().
+%% They apply to all actions except prefetch/prefetch_stop.
+-spec iterator_move(itr_ref(), iterator_action(), [task_limit()]) ->
+                           {ok, Key::binary(), Value::binary()} |
+                           {ok, Key::binary()} |
+                           {packed, Frames::binary()} |
+                           {continuation, Token::binary()} |
+                           {error, invalid_iterator | iterator_closed | timeout |
+                                   cancelled | busy}.
+iterator_move(IRef, Loc, Opts) ->
+    case async_iterator_move(undefined, IRef, Loc, Opts) of
     Ref when is_reference(Ref) ->
         receive
             {Ref, X}                    -> X
@@ -228,6 +329,49 @@ iterator_move(_IRef, _Loc) ->
     ER -> ER
     end.
 
+%% Queue a move without waiting for the iterator's earlier moves, so
+%% scattered seeks overlap with Erlang side processing.  Queued moves
+%% run in order and each replies {ItrRef, Id, Reply} to the caller;
+%% iterator_queue_reply/1 waits for one.  prefetch is not queueable.
+%% Queued and direct moves never share the iterator:  iterator_queue_move
+%% returns {error, busy} until a prefetch sequence is ended with
+%% prefetch_stop (or reaches the end), and iterator_move returns
+%% {error, busy} while queued moves are outstanding.
+-spec iterator_queue_move(itr_ref(), iterator_action()) -> {ok, queue_ref()} |
+                                                           {error, any()}.
+iterator_queue_move(IRef, Action) ->
+    case async_iterator_queue_move(IRef, Action) of
+        {Ref, Id}=QRef when is_reference(Ref), is_integer(Id) -> {ok, QRef};
+        ER -> ER
+    end.
+
+-spec iterator_queue_reply(queue_ref()) -> {ok, Key::binary(), Value::binary()} |
+                                           {ok, Key::binary()} |
+                                           {packed, Frames::binary()} |
+                                           {continuation, Token::binary()} |
+                                           {error, invalid_iterator} |
+                                           {error, iterator_closed}.
+iterator_queue_reply({Ref, Id}) ->
+    receive
+        {Ref, Id, X} -> X
+    end.
+
+-spec async_iterator_queue_move(itr_ref(), iterator_action()) -> queue_ref() | {error, any()}.
+async_iterator_queue_move(_IRef, _IterAction) ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Split the binary returned by a {packed, N} move.  Frames are
+%% <<KeyLen:32, Key, ValueLen:32, Value>>, or only the key half
+%% for a keys_only iterator.
+-spec unpack_frames(binary(), keys_only | key_value) -> [binary() | {binary(), binary()}].
+unpack_frames(<<>>, _Mode) ->
+    [];
+unpack_frames(<<KLen:32/unsigned, K:KLen/binary, Rest/binary>>, keys_only) ->
+    [K | unpack_frames(Rest, keys_only)];
+unpack_frames(<<KLen:32/unsigned, K:KLen/binary,
+                VLen:32/unsigned, V:VLen/binary, Rest/binary>>, key_value) ->
+    [{K, V} | unpack_frames(Rest, key_value)].
+
 -spec iterator_close(itr_ref()) -> ok.
 iterator_close(IRef) ->
     CallerRef = make_ref(),
@@ -237,6 +381,49 @@ iterator_close(IRef) ->
 async_iterator_close(_CallerRef, _IRef) ->
     erlang:nif_error({error, not_loaded}).
 
+%% Iterate several databases as one key ordered sequence.  Entries are
+%% tagged with the 1 based position of their database in Refs.
+-spec merge_iterator([db_ref()], read_options()) -> {ok, merge_itr_ref()}.
+merge_iterator(Refs, Opts) ->
+    CallerRef = make_ref(),
+    async_merge_iterator(CallerRef, Refs, Opts),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+-spec merge_iterator([db_ref()], read_options(), keys_only) -> {ok, merge_itr_ref()}.
+merge_iterator(Refs, Opts, keys_only) ->
+    CallerRef = make_ref(),
+    async_merge_iterator(CallerRef, Refs, Opts, keys_only),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+async_merge_iterator(_CallerRef, _Refs, _Opts) ->
+    erlang:nif_error({error, not_loaded}).
+
+async_merge_iterator(_CallerRef, _Refs, _Opts, keys_only) ->
+    erlang:nif_error({error, not_loaded}).
+
+%% first and Key (seek) reposition every source, next continues.  Each
+%% call returns up to Batch entries.
+-spec merge_iterator_move(merge_itr_ref(), first | next | binary(), pos_integer()) ->
+                                 {ok, [merge_entry()]} |
+                                 {error, invalid_iterator} |
+                                 {error, iterator_closed}.
+merge_iterator_move(MRef, Action, Batch) ->
+    CallerRef = make_ref(),
+    async_merge_iterator_move(CallerRef, MRef, Action, Batch),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+async_merge_iterator_move(_CallerRef, _MRef, _Action, _Batch) ->
+    erlang:nif_error({error, not_loaded}).
+
+-spec merge_iterator_close(merge_itr_ref()) -> ok.
+merge_iterator_close(MRef) ->
+    CallerRef = make_ref(),
+    async_merge_iterator_close(CallerRef, MRef),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+async_merge_iterator_close(_CallerRef, _MRef) ->
+    erlang:nif_error({error, not_loaded}).
+
 -type fold_fun() :: fun(({Key::binary(), Value::binary()}, any()) -> any()).
 
 %% Fold over the keys and values in the database
@@ -244,7 +431,7 @@ async_iterator_close(_CallerRef, _IRef) ->
 -spec fold(db_ref(), fold_fun(), any(), fold_options()) -> any().
 fold(Ref, Fun, Acc0, Opts) ->
     {ok, Itr} = iterator(Ref, Opts),
-    do_fold(Itr, Fun, Acc0, Opts).
+    do_fold(Itr, Fun, Acc0, Opts, key_value).
 
 -type fold_keys_fun() :: fun((Key::binary(), any()) -> any()).
 
@@ -253,16 +440,198 @@ fold(Ref, Fun, Acc0, Opts) ->
 -spec fold_keys(db_ref(), fold_keys_fun(), any(), read_options()) -> any().
 fold_keys(Ref, Fun, Acc0, Opts) ->
     {ok, Itr} = iterator(Ref, Opts, keys_only),
-    do_fold(Itr, Fun, Acc0, Opts).
+    do_fold(Itr, Fun, Acc0, Opts, keys_only).
 
--spec status(db_ref(), Key::binary()) -> {ok, binary()} | error.
+%% Status properties are read on a worker thread (bulk class), so a
+%% slow "leveldb.stats" on a large database does not hold a scheduler.
+-spec status(db_ref(), Key::binary()) -> {ok, binary()} | error | {error, einval}.
 status(Ref, Key) ->
-    eleveldb_bump:small(),
-    status_int(Ref, Key).
+    CallerRef = make_ref(),
+    async_status(CallerRef, Ref, Key),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+%% Several status properties in one worker task, results in Keys order.
+-spec status_multi(db_ref(), [Key::binary()]) ->
+                          [{binary(), {ok, binary()} | error}] | {error, einval}.
+status_multi(Ref, Keys) ->
+    CallerRef = make_ref(),
+    async_status(CallerRef, Ref, Keys),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+-spec async_status(reference(), db_ref(), binary() | [binary()]) -> ok.
+async_status(_CallerRef, _Ref, _Keys) ->
+    erlang:nif_error({error, not_loaded}).
 
 status_int(_Ref, _Key) ->
     erlang:nif_error({error, not_loaded}).
 
+%% Worker thread pool counters.  With eleveldb_pool_shards > 1, or
+%% one shard per NUMA node with eleveldb_numa, each database has a
+%% home shard of the pool; cpus is the number of cpus the shard's
+%% threads are pinned to (0 if not pinned); direct counts tasks started
+%% on their home shard, stolen those started by another shard's idle
+%% thread, queued those that waited for a thread.  classes holds
+%% queue depth and wait/run times (microseconds) of the interactive,
+%% bulk (prefetch, packed and sequential scans) and admin (open,
+%% close, destroy) tasks.  resizes counts set_threads/1 calls,
+%% retiring the replaced thread sets still finishing their queues.
+-spec pool_status() -> [{threads, pos_integer()} |
+                        {resizes, non_neg_integer()} |
+                        {retiring, non_neg_integer()} |
+                        {shards, [[{atom(), non_neg_integer()}]]} |
+                        {classes, [{interactive | bulk | admin,
+                                    [{atom(), non_neg_integer()}]}]}].
+pool_status() ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Resize the worker pool (eleveldb_threads) without a restart.
+%% Tasks already queued finish on the old threads, which a later
+%% database or iterator call releases once they are idle.  N is raised
+%% to eleveldb_pool_shards if smaller.
+-spec set_threads(pos_integer()) -> ok.
+set_threads(_N) ->
+    erlang:nif_error({error, not_loaded}).
+
+%% All open databases share one memory budget (total_leveldb_mem).
+%% Every eleveldb_memory_interval seconds a rebalance measures each
+%% database's block cache, file cache and memtable bytes and gives it
+%% half an even share of the budget plus its share of the other half
+%% by tasks run since the previous rebalance.  used and the
+%% per database values are as of that rebalance.  A database's budget
+%% is advisory: it only decides which databases drop their pooled
+%% iterators, leveldb's caches are sized from the node budget.
+%% cgroup_limit is the
+%% container memory limit (0 if none), read at load and by each
+%% rebalance; when it is below total_memory the budget is based on it.
+%% shed_percent is the part of the budget given back by shrink_caches/1
+%% or the high watermark, reclaimed the bytes that gave back in total.
+-spec memory_status() -> [{budget | cgroup_limit | used | rebalances |
+                           shed_percent | reclaimed, non_neg_integer()} |
+                          {databases, [[{name, binary()} |
+                                        {budget | used | block_cache | file_cache |
+                                         memtable | tasks, non_neg_integer()}]]}].
+memory_status() ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Give back Fraction of the memory budget under memory pressure:
+%% leveldb's block and file caches shrink to the smaller budget and
+%% pooled iterators are released.  Returns the bytes the databases'
+%% caches and memtables shrank by.  The budget stays reduced until
+%% shrink_caches(0) or, with eleveldb_memory_high_watermark set
+%% (percent of memory), until resident memory falls back below it.
+-spec shrink_caches(float() | 0 | 1) -> {ok, non_neg_integer()} | {error, any()}.
+shrink_caches(Fraction) ->
+    CallerRef = make_ref(),
+    async_shrink_caches(CallerRef, Fraction),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+async_shrink_caches(_CallerRef, _Fraction) ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Latency percentiles in microseconds per task type since load:
+%% wait is submit to a worker thread picking the task up, service is
+%% the time leveldb spent on it.  Percentiles are within 1/16 of the
+%% true value.  Work run on dirty I/O schedulers is not included.
+-type latency_summary() :: #{count => non_neg_integer(),
+                             p50 => non_neg_integer(),
+                             p99 => non_neg_integer(),
+                             p999 => non_neg_integer(),
+                             max => non_neg_integer()}.
+-spec task_latency() -> #{get | write | move | open | close | other =>
+                              #{wait | service => latency_summary()}}.
+task_latency() ->
+    maps:from_list([{Type, maps:from_list([{Time, maps:from_list(Summary)}
+                                           || {Time, Summary} <- Times])}
+                    || {Type, Times} <- task_latency_int()]).
+
+task_latency_int() ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Snapshot for metrics exporters, cheap enough to poll every second.
+%% perf holds every leveldb perf counter by its perf_dump name, pool
+%% the pool_status/0 counters, latency task_latency/0, memory the
+%% memory_status/0 totals, and databases the counters of each open
+%% database by the path it was opened with.  Per database cache and
+%% memtable sizes are as of the last memory rebalance.
+-spec metrics() -> #{perf := #{atom() => non_neg_integer()},
+                     pool := map(),
+                     latency := map(),
+                     memory := #{atom() => non_neg_integer()},
+                     databases := #{binary() => #{atom() => non_neg_integer()}}}.
+metrics() ->
+    {Perf, Dbs} = metrics_int(),
+    Pool = pool_status(),
+    Shards = [maps:from_list(Shard) || Shard <- proplists:get_value(shards, Pool)],
+    Classes = maps:from_list([{Class, maps:from_list(Counters)}
+                              || {Class, Counters} <- proplists:get_value(classes, Pool)]),
+    Memory = lists:keydelete(databases, 1, memory_status()),
+    #{perf => maps:from_list(Perf),
+      pool => maps:merge(maps:from_list(Pool), #{shards => Shards, classes => Classes}),
+      latency => task_latency(),
+      memory => maps:from_list(Memory),
+      databases => maps:from_list([{proplists:get_value(name, Db),
+                                    maps:from_list(lists:keydelete(name, 1, Db))}
+                                   || Db <- Dbs])}.
+
+metrics_int() ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Operation and byte counters of one database since it was opened:
+%% gets (hits plus misses), writes (batches), bytes_in (key and value
+%% bytes written, deletes count their key), bytes_out (value bytes
+%% returned by gets, key and value bytes read by iterators), moves
+%% (iterator steps, including prefetch) and stalls (iterator moves
+%% that had to wait for a prefetch still running).  The same counters
+%% are in each database of metrics/0.
+-spec db_stats(db_ref()) -> #{gets | hits | misses | writes | bytes_in |
+                              bytes_out | moves | stalls => non_neg_integer()}.
+db_stats(Ref) ->
+    maps:from_list(db_stats_int(Ref)).
+
+db_stats_int(_Ref) ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Open iterators of the database, merge iterator sources included, to
+%% find leaked ones:  age and idle (seconds since creation and since
+%% the last move), moves, the sequence number its snapshot pins (none
+%% with {snapshot, none}) and the owner, the process that created it.
+%% With iterator_idle_close set (seconds), each memory rebalance closes
+%% iterators idle that long, see close_idle_iterators/2.
+-spec iterators(db_ref()) -> [#{age | idle | moves => non_neg_integer(),
+                                snapshot => non_neg_integer() | none,
+                                owner => pid()}].
+iterators(Ref) ->
+    [maps:from_list(Itr) || Itr <- iterators_int(Ref)].
+
+%% Close the database's iterators idle Seconds or more now, as each
+%% memory rebalance does with iterator_idle_close.  Returns the number
+%% closed.  A move racing the close returns {error, iterator_closed};
+%% later moves fail with badarg, as after iterator_close/1.
+-spec close_idle_iterators(db_ref(), non_neg_integer()) -> {ok, non_neg_integer()} |
+                                                          {error, any()}.
+close_idle_iterators(Ref, Seconds) ->
+    CallerRef = make_ref(),
+    async_close_idle_iterators(CallerRef, Ref, Seconds),
+    ?WAIT_FOR_REPLY(CallerRef).
+
+async_close_idle_iterators(_CallerRef, _Ref, _Seconds) ->
+    erlang:nif_error({error, not_loaded}).
+
+iterators_int(_Ref) ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Token for the {cancel, Token} option.  One token may be given to
+%% any number of gets, writes and moves, e.g. all those serving one
+%% client request.
+-spec cancel_token() -> cancel_token().
+cancel_token() ->
+    erlang:nif_error({error, not_loaded}).
+
+%% Tasks holding Token that have not started reply {error, cancelled}.
+-spec cancel(cancel_token()) -> ok.
+cancel(_Token) ->
+    erlang:nif_error({error, not_loaded}).
+
 -spec async_destroy(reference(), string(), open_options()) -> ok.
 async_destroy(_CallerRef, _Name, _Opts) ->
     erlang:nif_error({error, not_loaded}).
@@ -274,9 +643,35 @@ destroy(Name, Opts) ->
     async_destroy(CallerRef, Name, Opts2),
     ?WAIT_FOR_REPLY(CallerRef).
 
+-type repair_progress() :: [{logs | tables | entries | bytes, non_neg_integer()}].
+
+%% Repair runs on an admin class worker thread.  repair/3 calls
+%% ProgressFun about once a second, and once more when the repair
+%% ends, with the log files converted, table files scanned, entries
+%% found so far and, in the last call, the bytes recovered.
+-spec repair(string(), open_options()) -> ok | {error, any()}.
 repair(Name, Opts) ->
-    eleveldb_bump:big(),
-    repair_int(Name, Opts).
+    repair(Name, Opts, fun(_Progress) -> ok end).
+
+-spec repair(string(), open_options(), fun((repair_progress()) -> any())) ->
+                    ok | {error, any()}.
+repair(Name, Opts, ProgressFun) ->
+    CallerRef = make_ref(),
+    async_repair(CallerRef, Name, Opts),
+    wait_for_repair(CallerRef, ProgressFun).
+
+wait_for_repair(CallerRef, ProgressFun) ->
+    receive
+        {CallerRef, {repair_progress, Progress}} ->
+            ProgressFun(Progress),
+            wait_for_repair(CallerRef, ProgressFun);
+        {CallerRef, Reply} ->
+            Reply
+    end.
+
+-spec async_repair(reference(), string(), open_options()) -> ok.
+async_repair(_CallerRef, _Name, _Opts) ->
+    erlang:nif_error({error, not_loaded}).
 
 repair_int(_Name, _Opts) ->
     erlang:nif_error({erlang, not_loaded}).
@@ -308,7 +703,16 @@ option_types(open) ->
      {is_internal_db, bool},
      {limited_developer_mem, bool},
      {eleveldb_threads, integer},
+     {eleveldb_pool_shards, integer},
+     {eleveldb_bulk_threads, integer},
+     {eleveldb_admin_threads, integer},
+     {eleveldb_cpu_set, any},
+     {eleveldb_numa, bool},
+     {eleveldb_memory_interval, integer},
+     {eleveldb_memory_high_watermark, integer},
      {fadvise_willneed, bool},
+     {iterator_pool_size, integer},
+     {iterator_idle_close, integer},
      {block_cache_threshold, integer},
      {delete_threshold, integer},
      {tiered_slow_level, integer},
@@ -317,14 +721,25 @@ option_types(open) ->
      {cache_object_warming, bool},
      {expiry_enabled, bool},
      {expiry_minutes, integer},
-     {whole_file_expiry, bool}];
+     {whole_file_expiry, bool},
+     {dirty_io, bool}];
 
 option_types(read) ->
     [{verify_checksums, bool},
      {fill_cache, bool},
-     {iterator_refresh, bool}];
+     {iterator_refresh, bool},
+     {iterator_refresh_interval, integer},
+     {iterator_refresh_moves, integer},
+     {iterator_refresh_bytes, integer},
+     {prefetch_depth, integer},
+     {scan_mode, any},
+     {snapshot, any},
+     {deadline, integer},
+     {cancel, any}];
 option_types(write) ->
-     [{sync, bool}].
+     [{sync, bool},
+      {deadline, integer},
+      {cancel, any}].
 
 -spec validate_options(open | read | write, [{atom(), any()}]) ->
                               {[{atom(), any()}], [{atom(), any()}]}.
@@ -361,14 +776,21 @@ add_open_defaults(Opts) ->
     end.
 
 
-do_fold(Itr, Fun, Acc0, Opts) ->
+do_fold(Itr, Fun, Acc0, Opts, Mode) ->
     try
         %% Extract {first_key, binary()} and seek to that key as a starting
         %% point for the iteration. The folding function should use throw if it
         %% wishes to terminate before the end of the fold.
         Start = proplists:get_value(first_key, Opts, first),
         true = is_binary(Start) or (Start == first),
-        fold_loop(iterator_move(Itr, Start), Itr, Fun, Acc0)
+        %% {fold_packed, N} fetches N entries per NIF reply after the first
+        case proplists:get_value(fold_packed, Opts) of
+            N when is_integer(N), N > 0 ->
+                packed_fold_loop(iterator_move(Itr, Start), Itr, {packed, N},
+                                 Mode, Fun, Acc0);
+            _ ->
+                fold_loop(iterator_move(Itr, Start), Itr, Fun, Acc0)
+        end
     after
         iterator_close(Itr)
     end.
@@ -384,6 +806,28 @@ fold_loop({ok, K, V}, Itr, Fun, Acc0) ->
     Acc = Fun({K, V}, Acc0),
     fold_loop(iterator_move(Itr, prefetch), Itr, Fun, Acc).
 
+packed_fold_loop({error, iterator_closed}, _Itr, _Move, _Mode, _Fun, Acc0) ->
+    throw({iterator_closed, Acc0});
+packed_fold_loop({error, invalid_iterator}, _Itr, _Move, _Mode, _Fun, Acc0) ->
+    Acc0;
+packed_fold_loop({ok, K}, Itr, Move, Mode, Fun, Acc0) ->
+    Acc = Fun(K, Acc0),
+    packed_fold_loop(iterator_move(Itr, Move), Itr, Move, Mode, Fun, Acc);
+packed_fold_loop({ok, K, V}, Itr, Move, Mode, Fun, Acc0) ->
+    Acc = Fun({K, V}, Acc0),
+    packed_fold_loop(iterator_move(Itr, Move), Itr, Move, Mode, Fun, Acc);
+packed_fold_loop({packed, Frames}, Itr, Move, Mode, Fun, Acc0) ->
+    Acc = fold_frames(Frames, Mode, Fun, Acc0),
+    packed_fold_loop(iterator_move(Itr, Move), Itr, Move, Mode, Fun, Acc).
+
+fold_frames(<<>>, _Mode, _Fun, Acc) ->
+    Acc;
+fold_frames(<<KLen:32/unsigned, K:KLen/binary, Rest/binary>>, keys_only, Fun, Acc) ->
+    fold_frames(Rest, keys_only, Fun, Fun(K, Acc));
+fold_frames(<<KLen:32/unsigned, K:KLen/binary,
+              VLen:32/unsigned, V:VLen/binary, Rest/binary>>, key_value, Fun, Acc) ->
+    fold_frames(Rest, key_value, Fun, Fun({K, V}, Acc)).
+
 validate_type({_Key, bool}, true)                            -> true;
 validate_type({_Key, bool}, false)                           -> true;
 validate_type({_Key, integer}, Value) when is_integer(Value) -> true;
@@ -430,6 +874,54 @@ fold_keys_test_Z() ->
                                                                 fun(K, Acc) -> [K | Acc] end,
                                                                 [], [])).
 
+merge_iterator_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.merge1.test /tmp/eleveldb.merge2.test"),
+    {ok, Ref1} = open("/tmp/eleveldb.merge1.test", [{create_if_missing, true}]),
+    {ok, Ref2} = open("/tmp/eleveldb.merge2.test", [{create_if_missing, true}]),
+    ok = ?MODULE:put(Ref1, <<"a">>, <<"1">>, []),
+    ok = ?MODULE:put(Ref1, <<"c">>, <<"3">>, []),
+    ok = ?MODULE:put(Ref2, <<"b">>, <<"2">>, []),
+    ok = ?MODULE:put(Ref2, <<"c">>, <<"4">>, []),
+    ok = ?MODULE:put(Ref2, <<"d">>, <<"5">>, []),
+    {ok, M} = merge_iterator([Ref1, Ref2], []),
+    {ok, [{1, <<"a">>, <<"1">>}, {2, <<"b">>, <<"2">>}, {1, <<"c">>, <<"3">>}]} =
+        merge_iterator_move(M, first, 3),
+    {ok, [{2, <<"c">>, <<"4">>}, {2, <<"d">>, <<"5">>}]} = merge_iterator_move(M, next, 3),
+    {error, invalid_iterator} = merge_iterator_move(M, next, 3),
+    {ok, [{1, <<"c">>, <<"3">>}]} = merge_iterator_move(M, <<"bb">>, 1),
+    ok = merge_iterator_close(M),
+    {error, iterator_closed} = merge_iterator_move(M, first, 1),
+    {ok, K} = merge_iterator([Ref1, Ref2], [], keys_only),
+    {ok, [{1, <<"a">>}, {2, <<"b">>}, {1, <<"c">>}, {2, <<"c">>}, {2, <<"d">>}]} =
+        merge_iterator_move(K, first, 10),
+    ok = merge_iterator_close(K),
+    ok = close(Ref1),
+    ok = close(Ref2).
+
+packed_fold_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.packed.fold.test"),
+    {ok, Ref} = open("/tmp/eleveldb.packed.fold.test", [{create_if_missing, true}]),
+    ok = ?MODULE:put(Ref, <<"def">>, <<"456">>, []),
+    ok = ?MODULE:put(Ref, <<"abc">>, <<"123">>, []),
+    ok = ?MODULE:put(Ref, <<"hij">>, <<"789">>, []),
+    ok = ?MODULE:put(Ref, <<"klm">>, <<>>, []),
+    [{<<"abc">>, <<"123">>},
+     {<<"def">>, <<"456">>},
+     {<<"hij">>, <<"789">>},
+     {<<"klm">>, <<>>}] = lists:reverse(fold(Ref, fun({K, V}, Acc) -> [{K, V} | Acc] end,
+                                              [], [{fold_packed, 2}])),
+    [<<"abc">>, <<"def">>, <<"hij">>, <<"klm">>] =
+        lists:reverse(fold_keys(Ref, fun(K, Acc) -> [K | Acc] end,
+                                [], [{fold_packed, 10}])),
+    {ok, Itr} = iterator(Ref, []),
+    {ok, <<"abc">>, <<"123">>} = iterator_move(Itr, first),
+    {packed, Frames} = iterator_move(Itr, {packed, 2}),
+    [{<<"def">>, <<"456">>}, {<<"hij">>, <<"789">>}] = unpack_frames(Frames, key_value),
+    {ok, <<"klm">>, <<>>} = iterator_move(Itr, next),
+    {error, invalid_iterator} = iterator_move(Itr, {packed, 2}),
+    ok = iterator_close(Itr),
+    ok = close(Ref).
+
 fold_from_key_test() -> [{fold_from_key_test_Z(), l} || l <- lists:seq(1, 20)].
 fold_from_key_test_Z() ->
     os:cmd("rm -rf /tmp/eleveldb.fold.fromkeys.test"),
@@ -480,6 +972,218 @@ compression_test_Z() ->
 	?assert(Log0Option =:= match andalso Log1Option =:= match).
 
 
+pool_status_test() ->
+    Status = pool_status(),
+    ?assert(0 < proplists:get_value(threads, Status)),
+    [Shard | _] = proplists:get_value(shards, Status),
+    ?assert(is_integer(proplists:get_value(cpus, Shard))),
+    ?assert(is_integer(proplists:get_value(queue_depth, Shard))),
+    ?assert(is_integer(proplists:get_value(submitted, Shard))),
+    Classes = proplists:get_value(classes, Status),
+    [?assert(is_integer(proplists:get_value(wait_us, proplists:get_value(C, Classes))))
+     || C <- [interactive, bulk, admin]].
+
+deadline_cancel_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.deadline.test"),
+    {ok, Ref} = open("/tmp/eleveldb.deadline.test", [{create_if_missing, true}]),
+    Past = erlang:monotonic_time(millisecond) - 1,
+    Future = erlang:monotonic_time(millisecond) + 60000,
+    ?assertEqual({error, timeout}, put(Ref, <<"a">>, <<"1">>, [{deadline, Past}])),
+    ok = put(Ref, <<"a">>, <<"1">>, [{deadline, Future}]),
+    ?assertEqual({error, timeout}, get(Ref, <<"a">>, [{deadline, Past}])),
+    ?assertEqual({ok, <<"1">>}, get(Ref, <<"a">>, [{deadline, Future}])),
+    Token = cancel_token(),
+    ?assertEqual({ok, <<"1">>}, get(Ref, <<"a">>, [{cancel, Token}])),
+    ok = cancel(Token),
+    ?assertEqual({error, cancelled}, get(Ref, <<"a">>, [{cancel, Token}])),
+    {ok, Itr} = iterator(Ref, []),
+    ?assertEqual({error, timeout}, iterator_move(Itr, first, [{deadline, Past}])),
+    ?assertEqual({ok, <<"a">>, <<"1">>}, iterator_move(Itr, first, [{deadline, Future}])),
+    ok = iterator_close(Itr),
+    Interactive = proplists:get_value(interactive, proplists:get_value(classes, pool_status())),
+    ?assert(3 =< proplists:get_value(expired, Interactive)),
+    ?assert(1 =< proplists:get_value(cancelled, Interactive)),
+    ok = close(Ref).
+
+repair_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.repair.test"),
+    {ok, Ref} = open("/tmp/eleveldb.repair.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    ok = close(Ref),
+    Self = self(),
+    ok = repair("/tmp/eleveldb.repair.test", [],
+                fun(Progress) -> Self ! {progress, Progress} end),
+    Progress = receive {progress, P} -> P after 0 -> [] end,
+    ?assert(is_integer(proplists:get_value(tables, Progress))),
+    {ok, Ref2} = open("/tmp/eleveldb.repair.test", []),
+    ?assertEqual({ok, <<"1">>}, get(Ref2, <<"a">>, [])),
+    ok = close(Ref2).
+
+status_multi_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.status.test"),
+    {ok, Ref} = open("/tmp/eleveldb.status.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    {ok, Stats} = status(Ref, <<"leveldb.stats">>),
+    ?assert(is_binary(Stats)),
+    ?assertEqual(error, status(Ref, <<"leveldb.no_such_property">>)),
+    [{<<"eleveldb.iterators">>, {ok, _}},
+     {<<"leveldb.no_such_property">>, error},
+     {<<"leveldb.stats">>, {ok, _}}] =
+        status_multi(Ref, [<<"eleveldb.iterators">>,
+                           <<"leveldb.no_such_property">>,
+                           <<"leveldb.stats">>]),
+    ?assertEqual([], status_multi(Ref, [])),
+    ok = close(Ref).
+
+task_latency_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.task_latency.test"),
+    {ok, Ref} = open("/tmp/eleveldb.task_latency.test", [{create_if_missing, true}]),
+    #{get := #{service := #{count := Gets0}}} = task_latency(),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    {ok, <<"1">>} = get(Ref, <<"a">>, []),
+    #{get := #{wait := Wait, service := #{count := Gets1, p50 := P50, p999 := P999}}} = task_latency(),
+    ?assertEqual(Gets0 + 1, Gets1),
+    ?assert(P50 =< P999),
+    ?assert(is_integer(maps:get(p99, Wait))),
+    ok = close(Ref).
+
+metrics_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.metrics.test"),
+    {ok, Ref} = open("/tmp/eleveldb.metrics.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    #{perf := Perf, pool := #{threads := Threads, classes := #{interactive := _}},
+      latency := #{get := _}, memory := #{budget := _},
+      databases := #{<<"/tmp/eleveldb.metrics.test">> := #{tasks := Tasks}}} = metrics(),
+    ?assert(0 < maps:size(Perf)),
+    ?assert(0 < Threads),
+    ?assert(0 < Tasks),
+    ok = close(Ref).
+
+db_stats_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.db_stats.test"),
+    {ok, Ref} = open("/tmp/eleveldb.db_stats.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"12">>, []),
+    ok = write(Ref, [{put, <<"b">>, <<"3">>}, {delete, <<"c">>}], []),
+    {ok, <<"12">>} = get(Ref, <<"a">>, []),
+    not_found = get(Ref, <<"z">>, []),
+    [<<"a">>, <<"b">>] = fold_keys(Ref, fun(K, Acc) -> Acc ++ [K] end, [], []),
+    #{gets := 2, hits := 1, misses := 1, writes := 2, bytes_in := 6,
+      bytes_out := BytesOut, moves := Moves, stalls := _} = db_stats(Ref),
+    ?assert(2 + 4 =< BytesOut),
+    ?assert(3 =< Moves),
+    #{<<"/tmp/eleveldb.db_stats.test">> := #{gets := 2}} = maps:get(databases, metrics()),
+    ok = close(Ref).
+
+iterators_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.iterators.test"),
+    {ok, Ref} = open("/tmp/eleveldb.iterators.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    [] = iterators(Ref),
+    {ok, I} = iterator(Ref, []),
+    {ok, <<"a">>, <<"1">>} = iterator_move(I, <<>>),
+    Self = self(),
+    [#{owner := Self, moves := 1, snapshot := Seq, age := _, idle := _}] = iterators(Ref),
+    ?assert(is_integer(Seq)),
+    {ok, I2} = iterator(Ref, [{snapshot, none}]),
+    {ok, <<"a">>, <<"1">>} = iterator_move(I2, first),
+    [Seq, none] = lists:sort([S || #{snapshot := S} <- iterators(Ref)]),
+    ok = iterator_close(I),
+    ok = iterator_close(I2),
+    [] = iterators(Ref),
+    ok = close(Ref).
+
+close_idle_iterators_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.close_idle.test"),
+    {ok, Ref} = open("/tmp/eleveldb.close_idle.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    ok = put(Ref, <<"b">>, <<"2">>, []),
+    {ok, I} = iterator(Ref, []),
+    {ok, <<"a">>, <<"1">>} = iterator_move(I, first),
+    {ok, 0} = close_idle_iterators(Ref, 3600),
+    {ok, <<"b">>, <<"2">>} = iterator_move(I, next),
+    {ok, 1} = close_idle_iterators(Ref, 0),
+    [] = iterators(Ref),
+    ?assertError(badarg, iterator_move(I, next)),
+    ?assertError(badarg, iterator_move(I, prefetch)),
+    ok = close(Ref).
+
+memory_status_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.memory_status.test"),
+    {ok, Ref} = open("/tmp/eleveldb.memory_status.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    Status = memory_status(),
+    ?assert(is_integer(proplists:get_value(budget, Status))),
+    ?assert(is_integer(proplists:get_value(cgroup_limit, Status))),
+    ?assert(is_integer(proplists:get_value(rebalances, Status))),
+    Names = [proplists:get_value(name, Db) || Db <- proplists:get_value(databases, Status)],
+    ?assert(lists:member(<<"/tmp/eleveldb.memory_status.test">>, Names)),
+    ok = close(Ref),
+    Names2 = [proplists:get_value(name, Db) || Db <- proplists:get_value(databases, memory_status())],
+    ?assertNot(lists:member(<<"/tmp/eleveldb.memory_status.test">>, Names2)).
+
+shrink_caches_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.shrink_caches.test"),
+    {ok, Ref} = open("/tmp/eleveldb.shrink_caches.test", [{create_if_missing, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    Budget = proplists:get_value(budget, memory_status()),
+    {ok, Reclaimed} = shrink_caches(0.5),
+    ?assert(is_integer(Reclaimed)),
+    ?assertEqual(50, proplists:get_value(shed_percent, memory_status())),
+    ?assert(proplists:get_value(budget, memory_status()) =< Budget),
+    {ok, _} = shrink_caches(0),
+    ?assertEqual(0, proplists:get_value(shed_percent, memory_status())),
+    ?assertEqual(Budget, proplists:get_value(budget, memory_status())),
+    ?assertError(badarg, shrink_caches(1.5)),
+    ok = close(Ref).
+
+set_threads_test() ->
+    Threads = proplists:get_value(threads, pool_status()),
+    Resizes = proplists:get_value(resizes, pool_status()),
+    os:cmd("rm -rf /tmp/eleveldb.set_threads.test"),
+    {ok, Ref} = open("/tmp/eleveldb.set_threads.test", [{create_if_missing, true}]),
+    ok = set_threads(Threads + 2),
+    ?assertEqual(Threads + 2, proplists:get_value(threads, pool_status())),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    ok = set_threads(Threads),
+    ?assertEqual({ok, <<"1">>}, get(Ref, <<"a">>, [])),
+    ?assertEqual(Resizes + 2, proplists:get_value(resizes, pool_status())),
+    ?assertError(badarg, set_threads(0)),
+    ok = close(Ref).
+
+set_threads_fold_test() ->
+    Threads = proplists:get_value(threads, pool_status()),
+    os:cmd("rm -rf /tmp/eleveldb.set_threads_fold.test"),
+    {ok, Ref} = open("/tmp/eleveldb.set_threads_fold.test", [{create_if_missing, true}]),
+    Keys = [<<N:32/big>> || N <- lists:seq(1, 2000)],
+    [ok = put(Ref, K, K, []) || K <- Keys],
+    %% retire the shard set under a running prefetch every 100 keys
+    Resize = fun({K, _V}, N) ->
+                     case N rem 100 of
+                         0 -> ok = set_threads(Threads + (N div 100) rem 2 + 1);
+                         _ -> ok
+                     end,
+                     ?assertEqual(<<N:32/big>>, K),
+                     N + 1
+             end,
+    ?assertEqual(2001, fold(Ref, Resize, 1, [])),
+    ok = set_threads(Threads),
+    ok = close(Ref).
+
+dirty_io_test() ->
+    os:cmd("rm -rf /tmp/eleveldb.dirty_io.test"),
+    {ok, Ref} = open("/tmp/eleveldb.dirty_io.test", [{create_if_missing, true},
+                                                      {dirty_io, true}]),
+    ok = put(Ref, <<"a">>, <<"1">>, []),
+    ok = write(Ref, [{put, <<"b">>, <<"2">>}, {delete, <<"a">>}], []),
+    ?assertEqual(not_found, get(Ref, <<"a">>, [])),
+    ?assertEqual({ok, <<"2">>}, get(Ref, <<"b">>, [])),
+    Ctx = make_ref(),
+    ok = async_put(Ref, Ctx, <<"c">>, <<"3">>, []),
+    receive {Ctx, ok} -> ok end,
+    ?assertEqual([<<"c">>, <<"b">>],
+                 fold_keys(Ref, fun(K, Acc) -> [K | Acc] end, [], [])),
+    ok = close(Ref).
+
 close_test() -> [{close_test_Z(), l} || l <- lists:seq(1, 20)].
 close_test_Z() ->
     os:cmd("rm -rf /tmp/eleveldb.close.test"),
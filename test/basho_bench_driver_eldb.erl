@@ -62,9 +62,31 @@ run(put, KeyGen, ValueGen, State) ->
             {ok, State};
         {error, Reason} ->
             {error, State, Reason}
+    end;
+run(seek_next, KeyGen, _ValueGen, State) ->
+    %% short range read, compares thread pool against {dirty_io, true}
+    Key = iolist_to_binary(KeyGen()),
+    {ok, Itr} = eleveldb:iterator(State#state.ref, []),
+    Result = seek_next(eleveldb:iterator_move(Itr, Key), Itr, 10),
+    eleveldb:iterator_close(Itr),
+    case Result of
+        ok ->
+            {ok, State};
+        {error, Reason} ->
+            {error, Reason, State}
     end.
 
 
+seek_next({ok, _K, _V}, _Itr, 0) ->
+    ok;
+seek_next({ok, _K, _V}, Itr, Count) ->
+    seek_next(eleveldb:iterator_move(Itr, next), Itr, Count-1);
+seek_next({error, invalid_iterator}, _Itr, _Count) ->
+    ok;
+seek_next({error, Reason}, _Itr, _Count) ->
+    {error, Reason}.
+
+
 print_status(Ref, Count) ->
     status_counter(Count, fun() ->
                                {ok, S} = eleveldb:status(Ref, <<"leveldb.stats">>),
@@ -36,8 +36,19 @@ iterator_test_() ->
        [
         prev_test_case(Ref),
         seek_and_next_test_case(Ref),
-        basic_prefetch_test_case(Ref),
-        seek_and_prefetch_test_case(Ref),
+        basic_prefetch_test_case(Ref, []),
+        seek_and_prefetch_test_case(Ref, []),
+        basic_prefetch_test_case(Ref, [{prefetch_depth, 2}]),
+        seek_and_prefetch_test_case(Ref, [{prefetch_depth, 2}]),
+        seek_and_prefetch_test_case(Ref, [{prefetch_depth, 16}]),
+        ring_prefetch_test_case(Ref),
+        refresh_policy_test_case(Ref),
+        pooled_iterator_test_case(Ref),
+        sequential_scan_test_case(Ref),
+        continuation_test_case(Ref),
+        no_snapshot_test_case(Ref),
+        queued_move_test_case(Ref),
+        queued_move_busy_test_case(Ref),
         aae_prefetch1(Ref),
         aae_prefetch2(Ref),
         aae_prefetch3(Ref)
@@ -75,18 +86,18 @@ seek_and_next_test_case(Ref) ->
             ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(I, next))
     end.
 
-basic_prefetch_test_case(Ref) ->
+basic_prefetch_test_case(Ref, Opts) ->
     fun() ->
-            {ok, I} = eleveldb:iterator(Ref, []),
+            {ok, I} = eleveldb:iterator(Ref, Opts),
             ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, <<>>)),
             ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, prefetch)),
             ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(I, prefetch)),
             ?assertEqual({ok, <<"d">>, <<"z">>},eleveldb:iterator_move(I, prefetch))
     end.
 
-seek_and_prefetch_test_case(Ref) ->
+seek_and_prefetch_test_case(Ref, Opts) ->
     fun() ->
-            {ok, I} = eleveldb:iterator(Ref, []),
+            {ok, I} = eleveldb:iterator(Ref, Opts),
             ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, <<"b">>)),
             ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(I, prefetch)),
             ?assertEqual({ok, <<"d">>, <<"z">>},eleveldb:iterator_move(I, prefetch_stop)),
@@ -113,6 +124,185 @@ seek_and_prefetch_test_case(Ref) ->
             ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, <<"a">>))
     end.
 
+ring_prefetch_test_case(Ref) ->
+    fun() ->
+            %% prefetch_stop in middle of ring must leave next/prev
+            %%  relative to last key returned
+            {ok, I} = eleveldb:iterator(Ref, [{prefetch_depth, 4}]),
+            ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, first)),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(I, prefetch_stop)),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, prev)),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(I, next)),
+            ?assertEqual({ok, <<"d">>, <<"z">>},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({error,invalid_iterator},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, first)),
+
+            {ok, K} = eleveldb:iterator(Ref, [{prefetch_depth, 4}], keys_only),
+            ?assertEqual({ok, <<"a">>},eleveldb:iterator_move(K, first)),
+            ?assertEqual({ok, <<"b">>},eleveldb:iterator_move(K, prefetch)),
+            ?assertEqual({ok, <<"c">>},eleveldb:iterator_move(K, prefetch)),
+            ?assertEqual({ok, <<"d">>},eleveldb:iterator_move(K, prefetch_stop)),
+            ?assertEqual({ok, <<"c">>},eleveldb:iterator_move(K, prev))
+    end.
+
+refresh_policy_test_case(Ref) ->
+    fun() ->
+            %% rebuild on every move must not change what the iterator sees
+            {ok, I} = eleveldb:iterator(Ref, [{iterator_refresh_moves, 1}]),
+            ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, first)),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, next)),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({ok, <<"d">>, <<"z">>},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({error,invalid_iterator},eleveldb:iterator_move(I, prefetch)),
+            {ok, Stats} = eleveldb:status(Ref, <<"eleveldb.iterators">>),
+            {match, [Refreshes]} = re:run(Stats, "refreshes: ([0-9]+)",
+                                          [{capture, all_but_first, list}]),
+            ?assert(0 < list_to_integer(Refreshes)),
+
+            {ok, J} = eleveldb:iterator(Ref, [{iterator_refresh_bytes, 2},
+                                              {iterator_refresh_interval, 0}]),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(J, <<"c">>)),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(J, prev)),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(J, next)),
+            ?assertEqual(ok, eleveldb:iterator_close(J))
+    end.
+
+pooled_iterator_test_case(Ref) ->
+    fun() ->
+            %% second iterator runs on the wrapper released by the first
+            {ok, I} = eleveldb:iterator(Ref, [{prefetch_depth, 4}]),
+            ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, first)),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual(ok, eleveldb:iterator_close(I)),
+            {ok, J} = eleveldb:iterator(Ref, [], keys_only),
+            ?assertEqual({ok, <<"d">>},eleveldb:iterator_move(J, last)),
+            ?assertEqual({ok, <<"c">>},eleveldb:iterator_move(J, prev)),
+            ?assertEqual({ok, <<"d">>},eleveldb:iterator_move(J, prefetch)),
+            ?assertEqual(ok, eleveldb:iterator_close(J)),
+            {ok, Stats} = eleveldb:status(Ref, <<"eleveldb.iterators">>),
+            ?assertMatch({match, _}, re:run(Stats, "pool_reuses: [1-9]"))
+    end.
+
+sequential_scan_test_case(Ref) ->
+    fun() ->
+            ?assertEqual([<<"a">>, <<"b">>, <<"c">>, <<"d">>],
+                         lists:reverse(eleveldb:fold_keys(Ref, fun(K, Acc) -> [K | Acc] end,
+                                                          [], [{scan_mode, sequential}]))),
+            {ok, Stats} = eleveldb:status(Ref, <<"eleveldb.iterators">>),
+            ?assertMatch({match, _}, re:run(Stats, "sequential_scans: [1-9]")),
+            ?assertMatch({match, _}, re:run(Stats, "sequential_bytes: [1-9]"))
+    end.
+
+continuation_test_case(Ref) ->
+    fun() ->
+            {ok, I} = eleveldb:iterator(Ref, []),
+            ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, first)),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, next)),
+            {continuation, T} = eleveldb:iterator_move(I, continuation),
+            ?assertEqual(ok, eleveldb:iterator_close(I)),
+
+            {ok, J} = eleveldb:iterator_resume(Ref, T, []),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(J, prefetch)),
+            ?assertEqual({ok, <<"d">>, <<"z">>},eleveldb:iterator_move(J, prefetch)),
+            ?assertEqual({error,invalid_iterator},eleveldb:iterator_move(J, prefetch)),
+            ?assertEqual(ok, eleveldb:iterator_close(J)),
+
+            {ok, K} = eleveldb:iterator_resume(Ref, T, [{prefetch_depth, 4}], keys_only),
+            ?assertEqual({ok, <<"c">>},eleveldb:iterator_move(K, prefetch)),
+            ?assertEqual({ok, <<"d">>},eleveldb:iterator_move(K, prefetch_stop)),
+            ?assertEqual(ok, eleveldb:iterator_close(K)),
+
+            %% token key need not exist, prev from a forward token
+            %%  returns the key before the gap
+            {ok, L} = eleveldb:iterator_resume(Ref, <<1, 0, "bb">>, []),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(L, prev)),
+            ?assertEqual(ok, eleveldb:iterator_close(L)),
+
+            {ok, M} = eleveldb:iterator(Ref, []),
+            ?assertEqual({ok, <<"d">>, <<"z">>},eleveldb:iterator_move(M, last)),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(M, prev)),
+            {continuation, R} = eleveldb:iterator_move(M, continuation),
+            ?assertEqual(ok, eleveldb:iterator_close(M)),
+            {ok, N} = eleveldb:iterator_resume(Ref, R, []),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(N, prev)),
+            ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(N, prev)),
+            ?assertEqual(ok, eleveldb:iterator_close(N))
+    end.
+
+no_snapshot_test_case(Ref) ->
+    fun() ->
+            {ok, Stats0} = eleveldb:status(Ref, <<"eleveldb.iterators">>),
+            Snapshots = snapshot_count(Stats0),
+            {ok, I} = eleveldb:iterator(Ref, [{snapshot, none}]),
+            ?assertEqual({ok, <<"a">>, <<"w">>},eleveldb:iterator_move(I, first)),
+            {ok, Stats1} = eleveldb:status(Ref, <<"eleveldb.iterators">>),
+            ?assertEqual(Snapshots, snapshot_count(Stats1)),
+            ?assertEqual({ok, <<"b">>, <<"x">>},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({ok, <<"c">>, <<"y">>},eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({ok, <<"d">>, <<"z">>},eleveldb:iterator_move(I, prefetch_stop)),
+            ?assertEqual(ok, eleveldb:iterator_close(I)),
+            ?assertEqual([<<"a">>, <<"b">>, <<"c">>, <<"d">>],
+                         lists:reverse(eleveldb:fold_keys(Ref, fun(K, Acc) -> [K | Acc] end,
+                                                          [], [{snapshot, none},
+                                                               {scan_mode, sequential}]))),
+            {ok, Stats2} = eleveldb:status(Ref, <<"eleveldb.iterators">>),
+            ?assertEqual(Snapshots, snapshot_count(Stats2))
+    end.
+
+queued_move_test_case(Ref) ->
+    fun() ->
+            {ok, I} = eleveldb:iterator(Ref, []),
+            Moves = [<<"c">>, next, <<"a">>, next, <<"bb">>, prev, last, next, {packed, 2}],
+            QRefs = [begin {ok, Q} = eleveldb:iterator_queue_move(I, M), Q end || M <- Moves],
+            ?assertEqual([{ok, <<"c">>, <<"y">>},
+                          {ok, <<"d">>, <<"z">>},
+                          {ok, <<"a">>, <<"w">>},
+                          {ok, <<"b">>, <<"x">>},
+                          {ok, <<"c">>, <<"y">>},
+                          {ok, <<"b">>, <<"x">>},
+                          {ok, <<"d">>, <<"z">>},
+                          {error, invalid_iterator},
+                          {error, invalid_iterator}],
+                         [eleveldb:iterator_queue_reply(Q) || Q <- QRefs]),
+
+            %% replies carry their request id, collect in any order
+            {ok, Q1} = eleveldb:iterator_queue_move(I, first),
+            {ok, Q2} = eleveldb:iterator_queue_move(I, next),
+            ?assertEqual({ok, <<"b">>, <<"x">>}, eleveldb:iterator_queue_reply(Q2)),
+            ?assertEqual({ok, <<"a">>, <<"w">>}, eleveldb:iterator_queue_reply(Q1)),
+            ?assertError(badarg, eleveldb:iterator_queue_move(I, prefetch)),
+            ?assertEqual(ok, eleveldb:iterator_close(I))
+    end.
+
+queued_move_busy_test_case(Ref) ->
+    fun() ->
+            %% classic prefetch owns the iterator until prefetch_stop
+            {ok, I} = eleveldb:iterator(Ref, []),
+            ?assertEqual({ok, <<"a">>, <<"w">>}, eleveldb:iterator_move(I, first)),
+            ?assertEqual({ok, <<"b">>, <<"x">>}, eleveldb:iterator_move(I, prefetch)),
+            ?assertEqual({error, busy}, eleveldb:iterator_queue_move(I, next)),
+            ?assertEqual({ok, <<"c">>, <<"y">>}, eleveldb:iterator_move(I, prefetch_stop)),
+            {ok, QI} = eleveldb:iterator_queue_move(I, next),
+            ?assertEqual({ok, <<"d">>, <<"z">>}, eleveldb:iterator_queue_reply(QI)),
+            ?assertEqual(ok, eleveldb:iterator_close(I)),
+
+            %% so does a prefetch ring holding read ahead entries
+            {ok, J} = eleveldb:iterator(Ref, [{prefetch_depth, 4}]),
+            ?assertEqual({ok, <<"a">>, <<"w">>}, eleveldb:iterator_move(J, first)),
+            ?assertEqual({ok, <<"b">>, <<"x">>}, eleveldb:iterator_move(J, prefetch)),
+            ?assertEqual({error, busy}, eleveldb:iterator_queue_move(J, next)),
+            ?assertEqual({ok, <<"c">>, <<"y">>}, eleveldb:iterator_move(J, prefetch_stop)),
+            {ok, QJ} = eleveldb:iterator_queue_move(J, next),
+            ?assertEqual({ok, <<"d">>, <<"z">>}, eleveldb:iterator_queue_reply(QJ)),
+            ?assertEqual(ok, eleveldb:iterator_close(J))
+    end.
+
+snapshot_count(Stats) ->
+    {match, [Count]} = re:run(Stats, "snapshots: ([0-9]+)",
+                              [{capture, all_but_first, list}]),
+    list_to_integer(Count).
+
 aae_prefetch1(Ref) ->
     fun() ->
             {ok, I} = eleveldb:iterator(Ref, []),